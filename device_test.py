@@ -126,11 +126,11 @@ class Host:
         msg = bytearray(self.header)
 
         msg.append(1) #function
-        msg.append(buf[4]) #data size 1
-        msg.append(buf[5]) #data size 2
+        msg.extend(struct.pack('%sH' % 1, url_size + 6)) #data size
         msg.append(url_size)
         msg.extend(url)
-        msg.extend(buf[7+url_size:10+url_size])
+        msg.extend(buf[7+url_size:10+url_size]) #channel and version
+        msg.extend(struct.pack('%sH' % 1, 0)) #generation, 0 never resumes the device state
 
         self.send(msg)
 
@@ -217,7 +217,7 @@ while running:
         elif int(var) == 4:
             for count in range(0,20):
                 mod.data_request()
-                time.sleep(0.2)
+                time.sleep(0.02) # below DEVICE_TIMEOUT_PERIOD
         # elif int(var) == 5:
             # mod.control_unassignment()
         else:
@@ -30,7 +30,7 @@ public:
 		minimum = ACEL_MIN;
 	}
 
-	float getValue( ){
+	reading_t getValue( ){
         static float mean0 = 0;
         static float mean1 = 0;
         static float mean2 = 0;
@@ -10,7 +10,7 @@ public:
         pinMode(BUTTON_PIN, INPUT);
     }
 
-    float getValue( ){
+    reading_t getValue( ){
         return digitalRead(BUTTON_PIN);
     }
 
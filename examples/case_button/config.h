@@ -1,4 +1,8 @@
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include "hal.h"
+#endif
 
 /*
 ************************************************************************************************************************
@@ -10,11 +14,10 @@ User configurations
 #define MAX_ASSIGNMENTS MAX_ACTUATORS + 0   // max number of assignments you can make, summing from all actuators.
 #define VALUE_CHANGE_TOLERANCE 0.01         // min difference between value and old value to consider a change in actuator.
 
-#define MAX_SCALE_POINTS 0                  // limit size of scale point array.
-#define MAX_FLOAT_COUNT MAX_SCALE_POINTS    // limit size of float array.
+#define MAX_SCALE_POINTS 0                  // scale points of all assignments, with their values and labels.
 
 #define MAX_STRING_SIZE 6                                       // max size of strings used in labels.
-#define MAX_STRING_COUNT MAX_SCALE_POINTS + MAX_ASSIGNMENTS*2   // max number of strings (assignments labels and units + scalepoints).
+#define MAX_STRING_COUNT MAX_ASSIGNMENTS*2                      // max number of strings (assignments labels and units).
 
 #define MAX_MODE_COUNT 10                   // Since modes can be shared between actuators, this is the number of modes contained in the mode_array.
 #define MAX_MODE_LABEL_SIZE MAX_STRING_SIZE // Size limit of mode label.
@@ -35,11 +38,9 @@ Arduino related
 #ifdef ARDUINO
 #define SET_PIN_MODE(pin, mode)         pinMode(pin, mode)
 #define DIGITAL_WRITE(pin, value)       digitalWrite(pin, value)
-#define RANDOM_FUNCTION(bottom, top)    random(bottom, top)
 #else
 #define SET_PIN_MODE(pin, mode)
 #define DIGITAL_WRITE(pin, value)
-#define RANDOM_FUNCTION(bottom, top)    10
 #endif
 
 #if  DEBUG_FLAG
@@ -0,0 +1 @@
+../../src/pool/pool.h
\ No newline at end of file
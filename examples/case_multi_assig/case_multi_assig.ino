@@ -32,7 +32,7 @@ public:
 		minimum = ACEL_MIN;
 	}
 
-	float getValue( ){
+	reading_t getValue( ){
         static float mean0 = 0;
         static float mean1 = 0;
         static float mean2 = 0;
@@ -70,7 +70,7 @@ public:
         pinMode(BUTTON_PIN, INPUT);
     }
 
-    float getValue(){
+    reading_t getValue(){
         return digitalRead(BUTTON_PIN);
     }
 
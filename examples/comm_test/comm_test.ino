@@ -14,5 +14,6 @@ void setup() {
 }
 
 void loop() {
-  delay(5000);
+    // the received frames are queued by the uart interrupt, recv_cb runs from here
+    comm_process();
 }
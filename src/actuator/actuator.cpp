@@ -28,50 +28,35 @@ void Actuator::printList(){
     // }while(ptr != assig_list_head);
 }
 
-// Since all chunks of assignments will be allocated consecutively, I simplified this bank.
-// There is no need to a free an assignment.
+// Assignment slots shared by all actuators. A slot is taken or given back in constant time, so actuators can change
+// their slots without a device reset.
 class AssignmentBank{
 
 public:
-    Assignment  bank[MAX_ASSIGNMENTS];
-    int         free_space;
-
-    AssignmentBank(){
-        int i;
-        free_space = MAX_ASSIGNMENTS;
-        for (i = 0; i < MAX_ASSIGNMENTS-1; ++i){
-            bank[i].setNext(&bank[i+1]);
-        }
-        for (++i; i > 0; --i){
-            bank[i].setPrevious(&bank[i-1]);
-        }
-    }
-    ~AssignmentBank(){}
-
-    // this will return a pointer to the head of a double-circular-linked list of assignments.
-    // In case of not enough free space, returns null.
-    Assignment* allocAssignmentList(int chunk_size){
-
-        if(free_space >= chunk_size){
-            free_space -= chunk_size;
-
-            // set list head as next of list tail.
-            bank[MAX_ASSIGNMENTS - (free_space+1)].setNext((Assignment*) &bank[MAX_ASSIGNMENTS - (free_space + chunk_size)]);
+    Pool<Assignment, MAX_ASSIGNMENTS> pool;
 
-            // set list tail as previous of list head.
-            bank[MAX_ASSIGNMENTS - (free_space + chunk_size)].setPrevious((Assignment*) &bank[MAX_ASSIGNMENTS - (free_space+1)]);
+    AssignmentBank(){}
+    ~AssignmentBank(){}
 
-            // next chunk head has its previous pointing to NULL.
-            bank[MAX_ASSIGNMENTS - free_space].setPrevious(0);
+    // returns a free slot or null if there is none.
+    Assignment* allocAssignment(){
+        Assignment* assig = pool.alloc();
 
-            return (Assignment*) &bank[MAX_ASSIGNMENTS - (free_space + chunk_size)];
+        if(assig){
+            assig->setPrevious(0);
+            assig->setNext(0);
         }
 
-        return 0;
+        return assig;
+    }
+
+    // gives back a slot, it must be available (unassigned).
+    void freeAssignment(Assignment* assig){
+        pool.free(assig);
     }
 
     int getFreeSpace(){
-        return free_space;
+        return pool.getFreeSpace();
     }
 
 };
@@ -81,13 +66,16 @@ static AssignmentBank assignBank;
 Actuator::Actuator(const char* name, uint8_t id, uint8_t num_assignments, Mode** modes, uint8_t num_modes, uint16_t* steps, uint8_t num_steps){
 
     this->name = name;
-    for (this->name_length = 0; name[this->name_length]; this->name_length++);
+    for (this->name_length = 0; name[this->name_length] && this->name_length < MAX_NAME_SIZE; this->name_length++);
     this->id = id;
 
     this->assignments_occupied = 0;
+    this->sample_period = 0;
 
-    this->num_assignments = num_assignments;
+    this->num_assignments = 0;
+    this->assignments_quota = num_assignments;
     this->current_assig = 0 ;
+    this->assig_list_head = 0;
 
     if(!modes){
         this->modes = 0;
@@ -95,7 +83,7 @@ Actuator::Actuator(const char* name, uint8_t id, uint8_t num_assignments, Mode**
     }
     else{
         this->modes = modes;
-        this->num_modes = num_modes;
+        this->num_modes = num_modes < MAX_ACTUATOR_MODES ? num_modes : MAX_ACTUATOR_MODES;
     }
 
     if(!steps){
@@ -104,7 +92,7 @@ Actuator::Actuator(const char* name, uint8_t id, uint8_t num_assignments, Mode**
     }
     else{
         this->steps = steps;
-        this->num_steps = num_steps;
+        this->num_steps = num_steps < MAX_STEPS_COUNT ? num_steps : MAX_STEPS_COUNT;
     }
 
 }
@@ -113,21 +101,75 @@ Actuator::~Actuator(){
 }
 
 void Actuator::init(){
+    // the slots already taken are kept, so init can run again without leaking them.
+    setAssignmentSlots(this->assignments_quota);
+}
 
-    if(assignBank.getFreeSpace() < this->num_assignments){
-        this->num_assignments = assignBank.getFreeSpace();
+// takes or gives back slots until the actuator holds count of them, the assigned ones are never given back. Returns
+// false if the bank ran out of slots or count is lower than the assigned ones.
+bool Actuator::setAssignmentSlots(uint8_t count){
+    Assignment* assig;
+
+    if(count < this->assignments_occupied){
+        return false;
     }
 
-    if(this->num_assignments){
-        this->assig_list_head = assignBank.allocAssignmentList(num_assignments);
+    this->assignments_quota = count;
+
+    // new slots go on the list tail, where the available ones are kept.
+    while(this->num_assignments < count && (assig = assignBank.allocAssignment())){
+        if(this->assig_list_head){
+            assig->setPrevious(this->assig_list_head->getPrevious());
+            assig->setNext(this->assig_list_head);
+            this->assig_list_head->getPrevious()->setNext(assig);
+            this->assig_list_head->setPrevious(assig);
+        }
+        else{
+            assig->setPrevious(assig);
+            assig->setNext(assig);
+            this->assig_list_head = assig;
+        }
+
+        this->num_assignments++;
     }
-    else{
-        this->assig_list_head = 0;
-        this->current_assig = 0 ;
-        // ERROR("Actuator with no assignment slots.");
+
+    // the available slots are given back from the tail on.
+    assig = this->assig_list_head ? this->assig_list_head->getPrevious() : 0;
+    while(this->num_assignments > count){
+        Assignment* previous = assig->getPrevious();
+
+        if(assig->getAvailable()){
+            if(assig == this->current_assig){
+                this->current_assig = (this->num_assignments > 1) ? previous : 0;
+            }
+
+            if(--this->num_assignments){
+                if(assig == this->assig_list_head){
+                    this->assig_list_head = assig->getNext();
+                }
+                previous->setNext(assig->getNext());
+                assig->getNext()->setPrevious(previous);
+            }
+            else{
+                this->assig_list_head = 0;
+            }
+
+            assignBank.freeAssignment(assig);
+        }
+
+        assig = previous;
     }
 
+    return this->num_assignments == count;
+}
+
+// slots left on the bank for other actuators.
+int Actuator::freeSlots(){
+    return assignBank.getFreeSpace();
+}
 
+pool_stats_t Actuator::slotPoolStats(){
+    return assignBank.pool.getStats();
 }
 
 Assignment* Actuator::getListHead(){
@@ -153,7 +195,12 @@ bool Actuator::assign(const uint8_t* ctrl_data){
     if(assignments_occupied < num_assignments){
         do{
             if(assig_ptr->getAvailable()){
-                assig_ptr->setup(ctrl_data);
+                // the scale points take a run of consecutive entries of their bank, which may be too fragmented to
+                // give it even with enough free entries. The slot is given back and the host told the assignment failed.
+                if(!assig_ptr->setup(ctrl_data)){
+                    assig_ptr->reset();
+                    return false;
+                }
 
                 // Now, current_assig has a valid assignment to point.
                 this->current_assig = assig_ptr;
@@ -180,34 +227,8 @@ bool Actuator::unassign(uint8_t assignment_id){
     }
     else{
         Assignment* ptr;
-        if(ptr = IdToPointer(assignment_id, assig_list_head)){
-            if(ptr == this->current_assig){
-                // If current_assig is the last assignment being used, it will point to null then.
-                if(assignments_occupied > 1)
-                    this->current_assig = this->current_assig->getPrevious();
-                else
-                    this->current_assig = 0;
-            }
-            ptr->reset();
-
-            // If ptr is pointing to the head, then ptr->next will be the new head.
-            if(ptr == this->assig_list_head)
-                this->assig_list_head = ptr->getNext();
-
-            // removes the node from the list.
-            ptr->getPrevious()->setNext(ptr->getNext());
-            ptr->getNext()->setPrevious(ptr->getPrevious());
-
-            // excluded node is the new tail.
-            ptr->setPrevious(assig_list_head->getPrevious());
-            ptr->setNext(assig_list_head);
-
-            // Making ptr visible to old tail and head.
-            ptr->getPrevious()->setNext(ptr);
-            assig_list_head->setPrevious(ptr);
-
-            assignments_occupied--;
-            return true;
+        if((ptr = IdToPointer(assignment_id, assig_list_head))){
+            return unassign(ptr);
         }
         else{
             // ERROR("Parameter id not found.");
@@ -216,6 +237,43 @@ bool Actuator::unassign(uint8_t assignment_id){
     return false;
 }
 
+// frees the assignment slot pointed by ptr, which must belong to this actuator.
+bool Actuator::unassign(Assignment* ptr){
+
+    if(!assignments_occupied || !ptr || ptr->getAvailable()){
+        // ERROR("No parameters addressed.");
+        return false;
+    }
+
+    if(ptr == this->current_assig){
+        // If current_assig is the last assignment being used, it will point to null then.
+        if(assignments_occupied > 1)
+            this->current_assig = this->current_assig->getPrevious();
+        else
+            this->current_assig = 0;
+    }
+    ptr->reset();
+
+    // If ptr is pointing to the head, then ptr->next will be the new head.
+    if(ptr == this->assig_list_head)
+        this->assig_list_head = ptr->getNext();
+
+    // removes the node from the list.
+    ptr->getPrevious()->setNext(ptr->getNext());
+    ptr->getNext()->setPrevious(ptr->getPrevious());
+
+    // excluded node is the new tail.
+    ptr->setPrevious(assig_list_head->getPrevious());
+    ptr->setNext(assig_list_head);
+
+    // Making ptr visible to old tail and head.
+    ptr->getPrevious()->setNext(ptr);
+    assig_list_head->setPrevious(ptr);
+
+    assignments_occupied--;
+    return true;
+}
+
 bool Actuator::supportMode(uint8_t relevant_properties, uint8_t property_values){
     for (int i = 0; i < num_modes; ++i){
         if(modes[i]->relevant_properties == relevant_properties &&
@@ -227,14 +285,14 @@ bool Actuator::supportMode(uint8_t relevant_properties, uint8_t property_values)
 }
 // checks if the value in the actuator changed.
 bool Actuator::checkChange(){
-    float value_diff = old_value - value;
+    value_t value_diff = old_value - value;
 
     if(value_diff < 0){
         value_diff = -value_diff;
     }
 
     if(assignments_occupied){
-        if(value_diff < VALUE_CHANGE_TOLERANCE){
+        if(value_diff < VALUE_FROM_FLOAT(VALUE_CHANGE_TOLERANCE)){
             return false;
         }
         else{
@@ -312,22 +370,21 @@ int Actuator::getDescriptor(uint8_t* buffer){
 
 }
 
-int Actuator::getUpdate(uint8_t *buffer){
+int Actuator::getUpdate(uint8_t *buffer, uint8_t encoding){
     int buf_counter=0;
-    uint8_t* float_ptr;
 
     buffer[buf_counter++] = this->current_assig->id;
 
-    float_ptr = (uint8_t*) &(this->value);
-
-    buffer[buf_counter++] = *float_ptr++;
-    buffer[buf_counter++] = *float_ptr++;
-    buffer[buf_counter++] = *float_ptr++;
-    buffer[buf_counter++] = *float_ptr;
+    buf_counter += this->current_assig->writeValue(&buffer[buf_counter], VALUE_TO_FLOAT(this->value), encoding);
 
     return buf_counter;
 }
 
+int Actuator::updateSize(uint8_t encoding){
+    // assignment id (1) + value
+    return 1 + this->current_assig->valueSize(encoding);
+}
+
 void Actuator::nextAssignment(){
     if(current_assig->available)
         return;
@@ -10,10 +10,47 @@
 #define MAX_ASSIGNMENTS 2
 #endif
 
+#ifndef MAX_NAME_SIZE
+#define MAX_NAME_SIZE   16 // longer actuator names (and device labels) are cut
+#endif
+
+#ifndef MAX_ACTUATOR_MODES
+#define MAX_ACTUATOR_MODES  3 // modes described by each actuator
+#endif
+
+#ifndef MAX_STEPS_COUNT
+#define MAX_STEPS_COUNT 4 // steps described by each actuator
+#endif
+
+// id (1) + name size (1) + name (n) + modes count (1) + modes (n) + slots (1) + steps count (1) + steps (2 each)
+#define ACTUATOR_DESCRIPTOR_MAX_SIZE    (5 + MAX_NAME_SIZE + MAX_ACTUATOR_MODES*MODE_DESCRIPTOR_MAX_SIZE + 2*MAX_STEPS_COUNT)
+
 #ifndef VALUE_CHANGE_TOLERANCE
 #define VALUE_CHANGE_TOLERANCE 0.01
 #endif
 
+// Actuator values are floats, or Q16.16 fixed point numbers (16 integer and 16 fraction bits, from -32768 to 32767.99998)
+// when FIXED_POINT_VALUES is defined. The fixed point ones spare the soft float operations on boards without a FPU,
+// they are converted to float on the updates only.
+#ifdef FIXED_POINT_VALUES
+typedef int32_t value_t;
+#define VALUE_ONE               65536L
+#define VALUE_FROM_FLOAT(f)     ((value_t) ((f) * VALUE_ONE + ((f) < 0 ? -0.5f : 0.5f)))
+#define VALUE_TO_FLOAT(v)       ((float) (v) / VALUE_ONE)
+#else
+typedef float value_t;
+#define VALUE_FROM_FLOAT(f)     ((value_t) (f))
+#define VALUE_TO_FLOAT(v)       ((float) (v))
+#endif
+
+// what getValue() returns, the fixed point values are computed from integer readings (e.g. analogRead()) so no float
+// is involved on the samples.
+#ifdef FIXED_POINT_VALUES
+typedef int32_t reading_t;
+#else
+typedef float reading_t;
+#endif
+
 // class Update;
 
 /*
@@ -30,25 +67,39 @@ public:
     uint16_t*           steps;
 
     uint8_t             num_assignments;    //how many parameters the actuator can support simultaneously.
+    uint8_t             assignments_quota;  // slots asked by the actuator, it holds fewer if the bank ran out.
     uint8_t             num_modes;          //how many modes the actuator have.
     uint8_t             num_steps;  //size of steps list.
 
     uint8_t             assignments_occupied;  //how many assignment slots the actuator have occupied until now.
 
+    uint16_t            sample_period;      // in ms, interval between calculateValue() calls, 0 samples on every run.
+
     bool                changed;
 
-    float               old_value;
-    float               value;
+    value_t             old_value;
+    value_t             value;
 
     Assignment*         current_assig;
     Assignment*         assig_list_head;
 
+    // the name is cut to MAX_NAME_SIZE, the modes to MAX_ACTUATOR_MODES and the steps to MAX_STEPS_COUNT.
     Actuator(const char* name, uint8_t id, uint8_t num_assignments, Mode** modes, uint8_t num_modes, uint16_t* steps, uint8_t num_steps);
 
     ~Actuator();
 
     void init();
 
+    // takes or gives back slots until the actuator holds count of them, the assigned ones are never given back.
+    // Returns false if the bank ran out of slots or count is lower than the assigned ones.
+    bool setAssignmentSlots(uint8_t count);
+
+    // slots left on the bank for other actuators.
+    static int freeSlots();
+
+    // usage of the slots shared by all actuators.
+    static pool_stats_t slotPoolStats();
+
     Assignment* getListHead();
 
     Assignment* getListTail();
@@ -62,6 +113,9 @@ public:
     // frees a parameter slot.
     bool unassign(uint8_t assignment_id);
 
+    // frees the parameter slot pointed, skipping the search by id.
+    bool unassign(Assignment* assignment);
+
     bool supportMode(uint8_t relevant_properties, uint8_t property_values);
 
     // checks if the value in the actuator changed.
@@ -77,8 +131,11 @@ public:
     // writes the actuator descriptor on the buffer.
     int getDescriptor(uint8_t* buffer);
 
-    // writes the current assignment id and value on buffer (used in data request).
-    int getUpdate(uint8_t *buffer);
+    // writes the current assignment id and value on buffer (used in data request), the value with the given encoding.
+    int getUpdate(uint8_t *buffer, uint8_t encoding = VALUE_ENCODING_FLOAT);
+
+    // returns the number of bytes getUpdate() writes with the given encoding.
+    int updateSize(uint8_t encoding = VALUE_ENCODING_FLOAT);
 
     // change current_assignment to next assignment.
     void nextAssignment();
@@ -93,7 +150,7 @@ public:
     virtual void calculateValue()=0;
 
     // reads analog or digital value
-    virtual float getValue()=0;
+    virtual reading_t getValue()=0;
 
     // This function will run after message has been sent.
     virtual void postMessageChanges()=0;
@@ -1,62 +1,10 @@
 #include "assignment.h"
-
-class ScalePointBank
-{
-public:
-    ScalePoint bank[MAX_SCALE_POINTS];
-    bool occupied[MAX_SCALE_POINTS];
-    int  free_space;
-
-    ScalePointBank(){
-        for (int i = 0; i < MAX_SCALE_POINTS; ++i){
-            occupied[i] = false;
-        }
-        free_space = MAX_SCALE_POINTS;
-    }
-    ~ScalePointBank(){}
-
-    ScalePoint* allocSP(){
-        for(int i = 0; i < MAX_SCALE_POINTS; ++i){
-            if(!occupied[i]){
-                occupied[i] = true;
-                bank[i].allocScalePoint();
-                free_space--;
-                return (ScalePoint*) &bank[i];
-            }
-        }
-        return 0;
-    }
-
-    void freeSP(ScalePoint* ptr){
-        long int index;
-
-        if(!ptr){
-            return;
-        }
-
-        index = (ptr-bank);
-
-        if(index >= 0 && index < MAX_SCALE_POINTS){
-            bank[index].freeScalePoint();
-            occupied[index] = false;
-            free_space++;
-        }
-
-    }
-
-    int getFreeSpace(){
-        return free_space;
-    }
-
-};
-static ScalePointBank spBank;
-
+#include <string.h>
 
 Assignment::Assignment(){
     this->port_properties = 0;
-    this->sp_list_ptr = 0;
-    this->list_aux = 0;
-    this->sp_list_size = 0;
+    this->steps = 0;
+    this->compact_size = sizeof(float);
 
     this->next = 0;
     this->previous = 0;
@@ -69,7 +17,7 @@ Assignment::~Assignment(){}
 void Assignment::reset(){
     this->label.freeStr();
     this->unit.freeStr();
-    this->freeScalePointList();
+    this->scale_points.free();
     this->id = 0;
     this->available = true;
 
@@ -103,6 +51,8 @@ bool Assignment::setup(const uint8_t* ctrl_data){
     this->steps = *((uint16_t*)(&ctrl_data[idx]));
     idx += sizeof(uint16_t);
 
+    this->compact_size = compactSize();
+
 
     if(this->label.allocStr()){
         this->label.setText((char*) &(ctrl_data[5]), label_size );
@@ -115,26 +65,23 @@ bool Assignment::setup(const uint8_t* ctrl_data){
 
         idx = idx + 1 /*string begin position*/ + ctrl_data[idx] /*string size*/ ; //scale point counter position
 
-        this->sp_list_size = ctrl_data[idx];
+        uint8_t sp_count = ctrl_data[idx];
 
-        if( allocScalePointList(this->sp_list_size) ){
+        if( this->scale_points.alloc(sp_count) ){
 
             idx++; //scale point label size position;
 
-            for (int i = 0; i < this->sp_list_size; ++i){
+            for (int i = 0; i < sp_count; ++i){
+                uint8_t sp_label_size = ctrl_data[idx];
+                float sp_value;
 
-                this->sp_list_ptr->setLabel(((char*) &ctrl_data[idx+1]),ctrl_data[idx]);
-                idx = idx + 1 /*string begin position*/ + ctrl_data[idx] /*string size*/ ; //scale point value position
-                this->sp_list_ptr->setValue(&ctrl_data[idx]);
+                idx = idx + 1 /*string begin position*/ + sp_label_size /*string size*/ ; //scale point value position
+                memcpy(&sp_value, &ctrl_data[idx], sizeof(float));
+                this->scale_points.add((char*) &ctrl_data[idx - sp_label_size], sp_label_size, sp_value);
                 idx = idx + sizeof(float); //next scale point label size position
-
-                if(this->sp_list_ptr->getNext())
-                    this->sp_list_ptr = this->sp_list_ptr->getNext();
             }
-            pointToListHead();
         }
         else{
-            this->sp_list_size = 0;
             return false;
         }
     }
@@ -142,67 +89,105 @@ bool Assignment::setup(const uint8_t* ctrl_data){
 }
 
 
-void Assignment::pointToListHead(){
-    while(this->sp_list_ptr->getPrevious()){
-        this->sp_list_ptr = this->sp_list_ptr->getPrevious();
+// returns the size of the data read by setup(), 0 if it goes beyond size.
+// masks (2) + id (1) + port properties (1) + label size (1) + label (n) + value, minimum, maximum and default (16) +
+// steps (2) + unit size (1) + unit (n) + scale points count (1) + (label size (1) + label (n) + value (4)) * count
+uint16_t Assignment::recordSize(const uint8_t* ctrl_data, uint16_t size){
+    uint16_t idx = 4;
+    uint8_t count;
+
+    if(idx >= size)
+        return 0;
+    idx += 1 + ctrl_data[idx] + 4*sizeof(float) + sizeof(uint16_t);
+
+    if(idx >= size)
+        return 0;
+    idx += 1 + ctrl_data[idx];
+
+    if(idx >= size)
+        return 0;
+    count = ctrl_data[idx++];
+
+    while(count--){
+        if(idx >= size)
+            return 0;
+        idx += 1 + ctrl_data[idx] + sizeof(float);
     }
+
+    return (idx <= size) ? idx : 0;
 }
 
-bool Assignment::allocScalePointList(int size){
-    if(size > spBank.getFreeSpace()){
-        return false;
+// chooses how the value goes on a compact update, the host makes the same choice from the assignment it sent.
+uint8_t Assignment::compactSize(){
+    float range = this->maximum - this->minimum;
+
+    if(this->port_properties & (MODE_PROPERTY_TOGGLE | MODE_PROPERTY_TRIGGER | MODE_PROPERTY_BYPASS)){
+        return 1;
     }
-    else{
-        while(size--){
-            this->sp_list_ptr = spBank.allocSP();
 
-            this->sp_list_ptr->setNext(this->list_aux);
-            if(this->list_aux)
-                this->list_aux->setPrevious(this->sp_list_ptr);
+    if((this->port_properties & MODE_PROPERTY_LOGARITHM) || !(range >= 0)){
+        return sizeof(float);
+    }
 
-            this->list_aux = this->sp_list_ptr;
-        }
-        this->list_aux = 0; // here, this->sp_list_ptr will be pointing to the head.
-        return true;
+    if(this->port_properties & MODE_PROPERTY_INTEGER){
+        if(range <= 0xFF)
+            return 1;
+        if(range <= 0xFFFF)
+            return 2;
     }
+    else if(this->steps){
+        return (this->steps <= 0xFF) ? 1 : 2;
+    }
+
+    return sizeof(float);
+}
 
+// returns the number of bytes writeValue() writes with the given encoding.
+int Assignment::valueSize(uint8_t encoding){
+    return (encoding == VALUE_ENCODING_FLOAT) ? sizeof(float) : this->compact_size;
 }
 
-void Assignment::freeScalePointList(){
-    if(!this->sp_list_ptr){
-        return;
+// writes value on buffer with the given encoding, returns the number of written bytes.
+int Assignment::writeValue(uint8_t* buffer, float value, uint8_t encoding){
+    float position;
+    uint16_t limit = (this->compact_size == 1) ? 0xFF : 0xFFFF;
+    uint16_t code;
+
+    if(encoding == VALUE_ENCODING_FLOAT || this->compact_size == sizeof(float)){
+        memcpy(buffer, &value, sizeof(float));
+        return sizeof(float);
+    }
+
+    // toggles are on from the middle of the range on, the others are positions from the minimum.
+    if(this->port_properties & (MODE_PROPERTY_TOGGLE | MODE_PROPERTY_TRIGGER | MODE_PROPERTY_BYPASS)){
+        position = (value >= (this->minimum + this->maximum) / 2 && value != this->minimum) ? 1 : 0;
+    }
+    else if(this->port_properties & MODE_PROPERTY_INTEGER){
+        position = value - this->minimum;
     }
     else{
-        pointToListHead();
-        while(this->sp_list_ptr){
-            this->list_aux = this->sp_list_ptr->getNext();
-            spBank.freeSP(this->sp_list_ptr);
-            this->sp_list_ptr = this->list_aux;
-        }
-        this->sp_list_size = 0;
-        this->sp_list_ptr = 0;
-        this->list_aux = 0;
+        position = (this->maximum > this->minimum) ?
+            (value - this->minimum) * this->steps / (this->maximum - this->minimum) : 0;
     }
+
+    // rounded and clamped to what compact_size holds
+    position += 0.5;
+    if(position < 0)
+        position = 0;
+    if(position > limit)
+        position = limit;
+    code = position;
+
+    buffer[0] = code & 0xFF;
+    if(this->compact_size == 2){
+        buffer[1] = code >> 8;
+    }
+
+    return this->compact_size;
 }
 
-void Assignment::printScalePoints(){ //vv
-    // if(!sp_list_size){
-    //  return;
-    // }
-
-    // char buff[10];
-    // int size;
-    // ScalePoint* ptr = this->sp_list_ptr;
-    // pointToListHead();
-    // while(ptr){
-    //  size = ptr->getLabel(buff);
-    //  for (int i = 0; i < size; ++i){
-    //      cout << buff[i];
-    //  }
-    //  cout << ": " << ptr->getValue() << endl;
-    //  ptr = ptr->getNext();
-    // }
-    // cout << endl;
+int Assignment::nearestScalePoint(float value){
+    return this->scale_points.nearest(value);
 }
 
 
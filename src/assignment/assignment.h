@@ -8,10 +8,8 @@
 #include "str.h"
 #include "scalepoint.h"
 
-// size of scalepoint bank
-#ifndef MAX_SCALE_POINTS
-#define MAX_SCALE_POINTS 10
-#endif
+// value encodings of the data request updates, the host asks the compact one with FUNC_VALUE_ENCODING.
+enum{VALUE_ENCODING_FLOAT, VALUE_ENCODING_COMPACT};
 
 
 /*
@@ -29,6 +27,7 @@ public:
     float       maximum;            // Maximum value of the parameter
     float       default_value;      // Default value of the parameter
     uint16_t    steps;              // Number of segments in which the value range will be divided, this is more appropriate working with a incremenetal encoder.
+    uint8_t     compact_size;       // bytes of the value on a compact update, 4 if the float is sent.
 
     uint8_t     id;                 // Assignment Id.
 
@@ -36,9 +35,7 @@ public:
 
     Str         label;              // Assingment Label
     Str         unit;               // Assignment unit
-    ScalePoint  *sp_list_ptr;       // Pointer to SP list, normally its pointing to the head.
-    ScalePoint  *list_aux;          // List pointer auxiliar.
-    int         sp_list_size;       // Size of SP list.
+    ScalePointList scale_points;    // Scale points sorted by value.
 
     Assignment* next;
     Assignment* previous;
@@ -50,22 +47,26 @@ public:
     // free label, unit and scalepoints and set state to available
     void reset();
 
-    // allocate some scalepoints from scalepoint bank, in case the bank runs low of scalepoints,
-    // returns 0, otherwise, returns 1.
-    bool allocScalePointList(int size);
-
-    // free those scalepoints
-    void freeScalePointList();
-
-    // Makes sp_list_ptr points to first scale point.
-    void pointToListHead();
-
     // receives a pointer to msg begin and reads necessary data, assigning to its attributes.
     // if there is not enough scalepoints to alloc from bank, returns false.
     bool setup(const uint8_t* ctrl_data);
 
-    // This function was used addressing module test, it sends a readable description of its scalepoints.
-    void printScalePoints(); //vv
+    // returns the size of the data read by setup(), 0 if it goes beyond size.
+    static uint16_t recordSize(const uint8_t* ctrl_data, uint16_t size);
+
+    // chooses how the value goes on a compact update, the host makes the same choice from the assignment it sent:
+    // toggles, triggers and bypasses send 0 or 1 (1 byte), integers send the offset from minimum (1 or 2 bytes),
+    // stepped ranges send the step position (1 or 2 bytes) and the others, or logarithmic ones, the float (4 bytes).
+    uint8_t compactSize();
+
+    // returns the number of bytes writeValue() writes with the given encoding.
+    int valueSize(uint8_t encoding);
+
+    // writes value on buffer with the given encoding, returns the number of written bytes.
+    int writeValue(uint8_t* buffer, float value, uint8_t encoding);
+
+    // returns the position of the scale point closest to value, -1 if the assignment has none.
+    int nearestScalePoint(float value);
 
     void setNext(Assignment* next);
     Assignment* getNext();
@@ -0,0 +1,12 @@
+// src/config.h with room for more actuators and for scale points, so they can be measured.
+#ifndef BENCHMARK_CONFIG_H
+#define BENCHMARK_CONFIG_H
+
+#define MAX_SCALE_POINTS 16
+
+#include "../config.h"
+
+#undef MAX_ACTUATORS
+#define MAX_ACTUATORS   8
+
+#endif
@@ -0,0 +1 @@
+../device/device.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../hal/hal.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../impl_actuator/linearsensor.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../mode/mode.cpp
\ No newline at end of file
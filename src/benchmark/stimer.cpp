@@ -0,0 +1 @@
+../stimer/stimer.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../str/str.h
\ No newline at end of file
@@ -0,0 +1,383 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "hal.h"
+#include "comm.h"
+#include "device.h"
+#include "linearsensor.h"
+
+// Times the protocol stack hot paths on the host. The numbers don't translate to the 16 MHz parts, they tell which
+// paths cost the most and how each change moves them. Each line is: benchmark name, ns per operation, bytes handled per
+// operation and bytes per second (0 when the operation doesn't handle a frame).
+
+#define MIN_RUN_NS      100000000   // each benchmark runs at least this long
+
+class BenchSensor: public LinearSensor{
+public:
+	reading_t reading;
+
+	BenchSensor(const char* name, uint8_t id):LinearSensor(name, id, 1){
+		reading = 0;
+	}
+
+	reading_t getValue(){
+		reading = (reading < 1023) ? reading + 1 : 0;
+		return reading;
+	}
+};
+
+hal_loopback_t loopback;
+volatile uint32_t sink;
+
+Device* dev;
+BenchSensor* sensors[MAX_ACTUATORS];
+uint8_t dev_out[CHAIN_BUFFER_SIZE];
+uint16_t dev_out_size;
+uint32_t sent_bytes;
+
+uint8_t message[CHAIN_BUFFER_SIZE + HEADER_SIZE];
+uint16_t message_size;
+uint8_t record[CHAIN_BUFFER_SIZE];
+uint16_t record_size;
+uint8_t encoded[2*(CHAIN_BUFFER_SIZE + HEADER_SIZE)];
+uint16_t encoded_size;
+chain_t frame;
+Assignment assig;
+
+uint64_t now_ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// runs op until MIN_RUN_NS elapsed, doubling the iterations, and prints the time of each one.
+void bench(const char* name, uint32_t bytes_per_op, void (*op)(void)){
+	uint64_t start, elapsed;
+	uint32_t iterations = 1;
+
+	do{
+		iterations *= 2;
+		start = now_ns();
+		for (uint32_t i = 0; i < iterations; ++i){
+			op();
+		}
+		elapsed = now_ns() - start;
+	}while(elapsed < MIN_RUN_NS);
+
+	double ns_per_op = (double) elapsed / iterations;
+	printf("%-40s %10.1f %6u %14.0f\n", name, ns_per_op, bytes_per_op, bytes_per_op ? bytes_per_op * 1e9 / ns_per_op : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// messages
+
+// writes a host message on the message buffer, laid out like the received frames.
+void buildMessage(uint8_t function, const uint8_t* data, uint16_t data_size, uint8_t dest = CHAIN_FIRST_DEV_ADDR){
+	message[POS_SYNC] = CHAIN_SYNC_BYTE;
+	message[POS_DEST] = dest;
+	message[POS_ORIG] = HOST_ADDRESS;
+	message[POS_FUNC] = function;
+	message[POS_DATA_SIZE1] = data_size & 0xFF;
+	message[POS_DATA_SIZE2] = data_size >> 8;
+	if(data_size)
+		memcpy(&message[POS_DATA_SIZE2 + 1], data, data_size);
+
+	message_size = HEADER_SIZE + data_size;
+}
+
+// writes a control assignment record with the given number of scale points on the record buffer.
+void buildRecord(uint8_t actuator_id, uint8_t assignment_id, uint8_t scale_points){
+	const float values[] = {0.5, 0, 1, 0.5};
+	int i = 0;
+
+	record[i++] = actuator_id;
+	record[i++] = 0x00; // masks
+	record[i++] = 0x00;
+	record[i++] = assignment_id;
+	record[i++] = 0x00; // port properties
+	record[i++] = 4;
+	memcpy(&record[i], "Gain", 4);
+	i += 4;
+	memcpy(&record[i], values, sizeof(values));
+	i += sizeof(values);
+	record[i++] = 33; // steps
+	record[i++] = 0;
+	record[i++] = 2;
+	memcpy(&record[i], "dB", 2);
+	i += 2;
+
+	record[i++] = scale_points;
+	for (int j = 0; j < scale_points; ++j){
+		float value = j;
+
+		record[i++] = 3;
+		record[i++] = 's';
+		record[i++] = 'p';
+		record[i++] = '0' + j % 10;
+		memcpy(&record[i], &value, sizeof(value));
+		i += sizeof(value);
+	}
+
+	record_size = i;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// comm
+
+void frameReceived(chain_t* chain){
+	sink += chain->data_size;
+}
+
+void commEncode(){
+	comm_send(&frame);
+
+	// drops what was sent, the host side never reads it
+	loopback.from_device.head = loopback.from_device.tail = 0;
+}
+
+void commDecode(){
+	hal_loopback_host_write(&loopback, encoded, encoded_size);
+	comm_process();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// device
+
+// the device messages are written on dev_out, as the comm_frame_* functions would write them on the transmit buffer
+void outBegin(uint8_t destination, uint8_t origin, uint8_t function, uint16_t data_size){
+	(void) destination; (void) origin; (void) function;
+	sent_bytes = HEADER_SIZE + data_size;
+	dev_out_size = 0;
+}
+
+void outPutU8(uint8_t value){
+	dev_out[dev_out_size++] = value;
+}
+
+void outPut(const void* data, uint16_t size){
+	memcpy(&dev_out[dev_out_size], data, size);
+	dev_out_size += size;
+}
+
+bool outEnd(){
+	sink += sent_bytes;
+	return dev_out_size == sent_bytes - HEADER_SIZE;
+}
+
+const frame_writer_t out_writer = {outBegin, outPutU8, outPut, outEnd};
+
+void parseConnection(){
+	dev->state = CONNECTING;
+	dev->parse(message);
+}
+
+void parseMessage(){
+	dev->parse(message);
+}
+
+// the assignment is undone right away so the slot is free for the next one
+void parseAssignment(){
+	dev->parse(message);
+	dev->unassign(record[3]);
+}
+
+void parseDataRequest(){
+	dev->dirty[0] = (1 << MAX_ACTUATORS) - 1;
+	dev->parse(message);
+}
+
+void sendConnection(){
+	dev->sendMessage(FUNC_CONNECTION);
+}
+
+void sendDescriptor(){
+	dev->sendMessage(FUNC_DEVICE_DESCRIPTOR);
+}
+
+void sendDataRequest(){
+	dev->dirty[0] = (1 << MAX_ACTUATORS) - 1;
+	dev->sendMessage(FUNC_DATA_REQUEST);
+}
+
+void sendControlAssignment(){
+	dev->sendMessage(FUNC_CONTROL_ASSIGNMENT, 0);
+}
+
+void sendDescriptorFragment(){
+	dev->sendMessage(FUNC_DESCRIPTOR_FRAGMENT, 0);
+}
+
+// the whole response goes on a single fragment
+void sendDataFragment(){
+	dev->batch[0] = (1 << MAX_ACTUATORS) - 1;
+	dev->batch_fragments = 1;
+	dev->sendMessage(FUNC_DATA_FRAGMENT, 0);
+}
+
+void sendDataPush(){
+	dev->dirty[0] = (1 << MAX_ACTUATORS) - 1;
+	dev->sendMessage(FUNC_DATA_PUSH);
+}
+
+// a bulk assignment response with one status per actuator
+void sendBulkAssignment(){
+	uint8_t reply[1 + MAX_ACTUATORS] = {MAX_ACTUATORS};
+
+	dev->sendReply(FUNC_BULK_ASSIGNMENT, reply, sizeof(reply));
+}
+
+void sendError(){
+	dev->sendMessage(FUNC_ERROR, 0, "Not waiting data request.");
+}
+
+void assignmentSetup(){
+	assig.setup(&record[1]);
+	assig.reset();
+}
+
+void calculateValue(){
+	sensors[0]->calculateValue();
+	sink += sensors[0]->value;
+}
+
+void calculateLogValue(){
+	sensors[1]->calculateValue();
+	sink += sensors[1]->value;
+}
+
+int main(){
+	hal_transport_t transport;
+	char name[64];
+
+	hal_loopback_init(&loopback, &transport);
+	hal_set_transport(&transport);
+
+	printf("benchmark ns_per_op bytes_per_op bytes_per_s\n");
+
+	// frames of 64 data bytes, a few of them have to be escaped
+	comm_init(BAUD_RATE, WRITE_READ_PIN, frameReceived);
+
+	frame.destination = CHAIN_FIRST_DEV_ADDR;
+	frame.origin = HOST_ADDRESS;
+	frame.function = FUNC_DATA_REQUEST;
+	frame.data_size = 64;
+	for (int i = 0; i < frame.data_size; ++i){
+		frame.data[i] = (i % 16 == 0) ? CHAIN_SYNC_BYTE : i;
+	}
+
+	comm_send(&frame);
+	encoded_size = hal_loopback_host_read(&loopback, encoded, sizeof(encoded));
+
+	bench("comm.encode", encoded_size, commEncode);
+	bench("comm.decode", encoded_size, commDecode);
+
+	// a device with all actuators assigned
+	Device device("http://portalmod.com/devices/XP", "Benchmark Device", 1);
+	dev = &device;
+	dev->setWriter(&out_writer);
+
+	for (int i = 0; i < MAX_ACTUATORS; ++i){
+		sensors[i] = new BenchSensor("Knob", i + 1);
+		dev->addActuator(sensors[i]);
+	}
+	dev->init();
+
+	for (int i = 0; i < MAX_ACTUATORS; ++i){
+		buildRecord(i + 1, i + 1, 0);
+		dev->state = WAITING_CONTROL_ASSIGNMENT;
+		dev->assignControl(record);
+	}
+	dev->state = WAITING_DATA_REQUEST;
+
+	uint8_t connection[64];
+	connection[0] = dev->url_size;
+	memcpy(&connection[1], dev->url_id, dev->url_size);
+	connection[dev->url_size + 1] = dev->channel;
+	connection[dev->url_size + 2] = PROTOCOL_VERSION_BYTE1;
+	connection[dev->url_size + 3] = PROTOCOL_VERSION_BYTE2;
+	connection[dev->url_size + 4] = 0;
+	connection[dev->url_size + 5] = 0;
+
+	// the connection drops the assignments, so it goes on a device of its own
+	Device connecting("http://portalmod.com/devices/XP", "Benchmark Device", 1);
+	connecting.setWriter(&out_writer);
+	dev = &connecting;
+	buildMessage(FUNC_CONNECTION, connection, dev->url_size + 6);
+	bench("device.parse.connection", message_size, parseConnection);
+	dev = &device;
+
+	buildMessage(FUNC_DEVICE_DESCRIPTOR, 0, 0);
+	bench("device.parse.descriptor", message_size, parseMessage);
+	dev->state = WAITING_DATA_REQUEST;
+
+	// the first actuator slot is freed for it and taken back after
+	dev->unassign(1);
+	buildRecord(1, 0x40, 0);
+	buildMessage(FUNC_CONTROL_ASSIGNMENT, record, record_size);
+	bench("device.parse.control_assignment", message_size, parseAssignment);
+	buildRecord(1, 1, 0);
+	dev->assignControl(record);
+
+	uint8_t data_req[] = {0x00};
+	buildMessage(FUNC_DATA_REQUEST, data_req, sizeof(data_req));
+	snprintf(name, sizeof(name), "device.parse.data_request.%i", MAX_ACTUATORS);
+	bench(name, message_size, parseDataRequest);
+
+	uint8_t push_mode[] = {0x00, 0x00};
+	buildMessage(FUNC_PUSH_MODE, push_mode, sizeof(push_mode));
+	bench("device.parse.push_mode", message_size, parseMessage);
+
+	uint8_t encoding[] = {VALUE_ENCODING_FLOAT};
+	buildMessage(FUNC_VALUE_ENCODING, encoding, sizeof(encoding));
+	bench("device.parse.value_encoding", message_size, parseMessage);
+
+	// an unknown function is dropped by the dispatcher before any handler
+	buildMessage(0x30, 0, 0);
+	bench("device.parse.unknown_function", message_size, parseMessage);
+
+	dev->sendMessage(FUNC_CONNECTION);
+	bench("device.send.connection", sent_bytes, sendConnection);
+	dev->sendMessage(FUNC_DEVICE_DESCRIPTOR);
+	bench("device.send.descriptor", sent_bytes, sendDescriptor);
+	sendDataRequest();
+	snprintf(name, sizeof(name), "device.send.data_request.%i", MAX_ACTUATORS);
+	bench(name, sent_bytes, sendDataRequest);
+	sendControlAssignment();
+	bench("device.send.control_assignment", sent_bytes, sendControlAssignment);
+	sendDescriptorFragment();
+	bench("device.send.descriptor_fragment", sent_bytes, sendDescriptorFragment);
+	sendDataFragment();
+	snprintf(name, sizeof(name), "device.send.data_fragment.%i", MAX_ACTUATORS);
+	bench(name, sent_bytes, sendDataFragment);
+	sendDataPush();
+	snprintf(name, sizeof(name), "device.send.data_push.%i", MAX_ACTUATORS);
+	bench(name, sent_bytes, sendDataPush);
+	sendBulkAssignment();
+	snprintf(name, sizeof(name), "device.send.bulk_assignment.%i", MAX_ACTUATORS);
+	bench(name, sent_bytes, sendBulkAssignment);
+	dev->sendMessage(FUNC_ERROR, 0, "Not waiting data request.");
+	bench("device.send.error", sent_bytes, sendError);
+
+	const uint8_t scale_points[] = {0, 4, MAX_SCALE_POINTS};
+	for (int i = 0; i < (int) sizeof(scale_points); ++i){
+		buildRecord(1, 1, scale_points[i]);
+		snprintf(name, sizeof(name), "assignment.setup.scale_points.%i", scale_points[i]);
+		bench(name, record_size - 1, assignmentSetup);
+	}
+
+	bench("linearsensor.calculate_value", 0, calculateValue);
+
+	// a frequency like port, from 20 Hz to 20 kHz
+	Assignment* log_assig = sensors[1]->current_assig;
+	log_assig->port_properties = MODE_PROPERTY_LOGARITHM;
+	log_assig->minimum = 20;
+	log_assig->maximum = 20000;
+	sensors[1]->assignmentRotine();
+	bench("linearsensor.calculate_value.log", 0, calculateLogValue);
+
+	return 0;
+}
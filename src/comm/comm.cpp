@@ -2,10 +2,21 @@
 // includes
 #include "comm.h"
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <stdio.h>
+#include "hal.h"
+#endif
 
 // local functions prototypes
 static void byte_recv_cb(uint8_t byte);
+static uint8_t rx_full(void);
+#if defined(__AVR__) || defined(__SAM3X8E__)
+static uint8_t tx_get(uint8_t *byte);
+static uint8_t tx_last(void);
+static void tx_done(void);
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // AVR architecture
@@ -24,6 +35,11 @@ public:
         HardwareSerial(ubrrh, ubrrl, ucsra, ucsrb, ucsrc, udr) {}
 
     inline void _rx_complete_irq(void);
+    inline void _tx_udr_empty_irq(void);
+    inline void _tx_complete_irq(void);
+    void txStart(void);
+    void txCancelDone(void);
+    void txPoll(void);
     virtual size_t write(uint8_t c);
     using HardwareSerial::write;
 };
@@ -37,6 +53,47 @@ void HwSerial::_rx_complete_irq(void)
     }
 }
 
+void HwSerial::_tx_udr_empty_irq(void)
+{
+    uint8_t byte;
+
+    if (tx_get(&byte))
+    {
+        *_udr = byte;
+        sbi(*_ucsra, TXC0);
+    }
+    else
+    {
+        // buffer drained, if the frame is complete waits its last byte leave the shift register
+        cbi(*_ucsrb, UDRIE0);
+        if (tx_last()) sbi(*_ucsrb, TXCIE0);
+    }
+}
+
+void HwSerial::_tx_complete_irq(void)
+{
+    cbi(*_ucsrb, TXCIE0);
+    tx_done();
+}
+
+// enables the data register empty interrupt, which drains the transmit buffer
+void HwSerial::txStart(void)
+{
+    sbi(*_ucsrb, UDRIE0);
+}
+
+void HwSerial::txCancelDone(void)
+{
+    cbi(*_ucsrb, TXCIE0);
+}
+
+// used to move the transmit buffer when the interrupts are disabled
+void HwSerial::txPoll(void)
+{
+    if (bit_is_set(*_ucsra, UDRE0) && bit_is_set(*_ucsrb, UDRIE0))
+        _tx_udr_empty_irq();
+}
+
 // write one byte to register and wait until it to be send
 size_t HwSerial::write(uint8_t c)
 {
@@ -47,6 +104,10 @@ size_t HwSerial::write(uint8_t c)
     return 1;
 }
 
+#define IRQ_DISABLED()      bit_is_clear(SREG, SREG_I)
+#define ENTER_CRITICAL()    uint8_t _sreg = SREG; cli()
+#define EXIT_CRITICAL()     SREG = _sreg
+
 #ifdef HAVE_CDCSERIAL
 static Serial_ CommSerial;
 #else
@@ -68,6 +129,32 @@ static Serial_ CommSerial;
     {
         CommSerial._rx_complete_irq();
     }
+
+#if defined(USART_UDRE_vect)
+    ISR(USART_UDRE_vect)
+#elif defined(USART0_UDRE_vect)
+    ISR(USART0_UDRE_vect)
+#else
+#error "Don't know what the Data Register Empty vector is called for Serial"
+#endif
+    {
+        CommSerial._tx_udr_empty_irq();
+    }
+
+#if defined(USART_TX_vect)
+    ISR(USART_TX_vect)
+#elif defined(USART0_TX_vect)
+    ISR(USART0_TX_vect)
+#elif defined(USART_TXC_vect)
+    ISR(USART_TXC_vect) // ATmega8
+#else
+#error "Don't know what the Transmit Complete vector is called for Serial"
+#endif
+    {
+        CommSerial._tx_complete_irq();
+    }
+
+#define COMM_TX_IRQ
 #endif
 
 #endif // end of HAVE_CDCSERIAL
@@ -95,6 +182,10 @@ public:
         UARTClass(pUart, dwIrq, dwId, pRx_buffer) {}
 
     void IrqHandler(void);
+    inline void _tx_ready_irq(void);
+    void txStart(void);
+    void txCancelDone(void);
+    void txPoll(void);
     virtual size_t write(const uint8_t c);
     using UARTClass::write;
 };
@@ -109,6 +200,19 @@ void HwSerial::IrqHandler( void )
     if ((status & UART_SR_RXRDY) == UART_SR_RXRDY)
         byte_recv_cb(_pUart->UART_RHR);
 
+    // Is the transmitter ready to the next byte ?
+    if ((status & UART_SR_TXRDY) == UART_SR_TXRDY &&
+        (_pUart->UART_IMR & UART_IMR_TXRDY) == UART_IMR_TXRDY)
+        _tx_ready_irq();
+
+    // Did the last byte of the frame leave the transmitter ?
+    if ((status & UART_SR_TXEMPTY) == UART_SR_TXEMPTY &&
+        (_pUart->UART_IMR & UART_IMR_TXEMPTY) == UART_IMR_TXEMPTY)
+    {
+        _pUart->UART_IDR = UART_IDR_TXEMPTY;
+        tx_done();
+    }
+
     // Acknowledge errors
     if ((status & UART_SR_OVRE) == UART_SR_OVRE ||
         (status & UART_SR_FRAME) == UART_SR_FRAME)
@@ -118,6 +222,41 @@ void HwSerial::IrqHandler( void )
     }
 }
 
+void HwSerial::_tx_ready_irq(void)
+{
+    uint8_t byte;
+
+    if (tx_get(&byte))
+    {
+        _pUart->UART_THR = byte;
+    }
+    else
+    {
+        // buffer drained, if the frame is complete waits its last byte leave the shift register
+        _pUart->UART_IDR = UART_IDR_TXRDY;
+        if (tx_last()) _pUart->UART_IER = UART_IER_TXEMPTY;
+    }
+}
+
+// enables the transmitter ready interrupt, which drains the transmit buffer
+void HwSerial::txStart(void)
+{
+    _pUart->UART_IER = UART_IER_TXRDY;
+}
+
+void HwSerial::txCancelDone(void)
+{
+    _pUart->UART_IDR = UART_IDR_TXEMPTY;
+}
+
+// used to move the transmit buffer when the interrupts are disabled
+void HwSerial::txPoll(void)
+{
+    if ((_pUart->UART_SR & UART_SR_TXRDY) == UART_SR_TXRDY &&
+        (_pUart->UART_IMR & UART_IMR_TXRDY) == UART_IMR_TXRDY)
+        _tx_ready_irq();
+}
+
 // write one byte to register and wait until it to be send
 size_t HwSerial::write(const uint8_t c)
 {
@@ -127,8 +266,93 @@ size_t HwSerial::write(const uint8_t c)
     return 1;
 }
 
+#define IRQ_DISABLED()      __get_PRIMASK()
+#define ENTER_CRITICAL()    uint32_t _primask = __get_PRIMASK(); __disable_irq()
+#define EXIT_CRITICAL()     if (!_primask) __enable_irq()
+
+#define COMM_TX_IRQ
+
 #endif // end of __SAM3X8E__
 
+////////////////////////////////////////////////////////////////////////////////
+// Host (Linux) build
+
+#ifndef ARDUINO
+
+// the uart is replaced by the transport selected with hal_set_transport()
+class HwSerial
+{
+public:
+    void begin(uint32_t baud_rate);
+    void poll(void);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    void print(const char *str);
+    void print(int i);
+    void print(float f);
+};
+
+static HwSerial CommSerial;
+
+void HwSerial::begin(uint32_t baud_rate)
+{
+    hal_transport_t *transport = hal_get_transport();
+
+    if (transport) transport->open(transport->ctx, baud_rate);
+}
+
+// reads the transport and feeds the receiver, it plays the uart interrupt role
+// stops when the receive queue is full, the remaining bytes wait for the next call
+void HwSerial::poll(void)
+{
+    hal_transport_t *transport = hal_get_transport();
+    uint8_t byte;
+
+    if (!transport) return;
+
+    while (!rx_full() && transport->read(transport->ctx, &byte, 1) == 1)
+    {
+        byte_recv_cb(byte);
+    }
+}
+
+size_t HwSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HwSerial::write(const uint8_t *buffer, size_t size)
+{
+    hal_transport_t *transport = hal_get_transport();
+
+    if (!transport) return 0;
+
+    return transport->write(transport->ctx, buffer, size);
+}
+
+void HwSerial::print(const char *str)
+{
+    write((const uint8_t *) str, strlen(str));
+}
+
+void HwSerial::print(int i)
+{
+    char str[16];
+    snprintf(str, sizeof(str), "%d", i);
+    print(str);
+}
+
+void HwSerial::print(float f)
+{
+    char str[32];
+    snprintf(str, sizeof(str), "%.2f", f);
+    print(str);
+}
+
+#define COMM_RX_POLL()      CommSerial.poll()
+
+#endif // end of host build
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // local defines
@@ -139,15 +363,68 @@ enum {STATE_SYNC, STATE_DESTINATION, STATE_ORIGIN, STATE_FUNCTION,
 ////////////////////////////////////////////////////////////////////////////////
 // macros
 
+#if CHAIN_RX_QUEUE_SIZE == 1 || (CHAIN_RX_QUEUE_SIZE & (CHAIN_RX_QUEUE_SIZE - 1))
+#error "CHAIN_RX_QUEUE_SIZE must be 0 or a power of two greater than 1"
+#endif
+
+#define RX_QUEUE_MASK       (CHAIN_RX_QUEUE_SIZE - 1)
+
+// the uart interrupt feeds the receiver by itself, only the host build needs to poll it
+#ifndef COMM_RX_POLL
+#define COMM_RX_POLL()
+#endif
+
+// the host build receives from the main loop, so nothing runs concurrently with it
+#ifndef ENTER_CRITICAL
+#define ENTER_CRITICAL()
+#define EXIT_CRITICAL()
+#endif
+
+#if CHAIN_TX_BUFFER_SIZE < 2 || CHAIN_TX_BUFFER_SIZE > 256 || (CHAIN_TX_BUFFER_SIZE & (CHAIN_TX_BUFFER_SIZE - 1))
+#error "CHAIN_TX_BUFFER_SIZE must be a power of two between 2 and 256"
+#endif
+
+#define TX_BUFFER_MASK      (CHAIN_TX_BUFFER_SIZE - 1)
+
+// prevents the compiler from moving frame accesses across the queue indexes update
+#define COMPILER_BARRIER()  __asm__ __volatile__("" ::: "memory")
+
 #define READ_MODE(pin)      delayMicroseconds(1); digitalWrite(pin, LOW)
 #define WRITE_MODE(pin)     digitalWrite(pin, HIGH); delayMicroseconds(30)
 
 ////////////////////////////////////////////////////////////////////////////////
 // local variables
 static uint8_t g_oe_pin;
-static chain_t g_chain;
 static void (*g_parser_cb)(chain_t *chain_data) = NULL;
-static uint8_t g_fsm_state, g_address;
+static volatile uint8_t g_fsm_state;
+static volatile uint16_t g_rx_errors;
+static uint8_t g_addresses[CHAIN_MAX_ADDRESSES], g_addresses_count;
+
+// the device messages are streamed to the transmit buffer, so a reply can be built while the next frame arrives
+#if CHAIN_RX_QUEUE_SIZE
+// single producer (uart interrupt) single consumer (comm_process) frame queue
+// the slot pointed by the head is the one being received, so it's never handed to the consumer
+static chain_t g_rx_queue[CHAIN_RX_QUEUE_SIZE];
+static volatile uint8_t g_rx_head, g_rx_tail;
+static volatile uint16_t g_rx_overflows;
+static chain_t *g_rx_chain = &g_rx_queue[0];
+#else
+static chain_t g_rx_frame;
+static chain_t *g_rx_chain = &g_rx_frame;
+#endif
+
+// transmit ring buffer, filled by comm_send and drained by the uart interrupt. Without the interrupt it only stages
+// the bytes, so the serial gets whole buffers instead of one call per byte.
+static uint8_t g_tx_buffer[CHAIN_TX_BUFFER_SIZE];
+#ifdef COMM_TX_IRQ
+static volatile uint8_t g_tx_head, g_tx_tail;
+#else
+static uint16_t g_tx_count;
+#endif
+static volatile uint8_t g_tx_busy, g_tx_filling;
+static uint8_t g_tx_checksum;
+static uint16_t g_tx_remaining;
+static void (*g_tx_done_cb)(void) = NULL;
 
 ////////////////////////////////////////////////////////////////////////////////
 // local functions definitions
@@ -180,27 +457,103 @@ static uint8_t decode(uint8_t byte, uint8_t *decoded)
     return 1;
 }
 
-static uint8_t encode(uint8_t byte, uint8_t *buffer)
+static uint8_t rx_full(void)
+{
+#if CHAIN_RX_QUEUE_SIZE
+    return (uint8_t)(g_rx_head - g_rx_tail) == RX_QUEUE_MASK;
+#else
+    return 0;
+#endif
+}
+
+#ifdef COMM_TX_IRQ
+// called from the uart interrupt, takes the next byte to send
+static uint8_t tx_get(uint8_t *byte)
+{
+    if (g_tx_tail == g_tx_head) return 0;
+
+    *byte = g_tx_buffer[g_tx_tail];
+    g_tx_tail = (g_tx_tail + 1) & TX_BUFFER_MASK;
+
+    return 1;
+}
+
+// tells the uart interrupt if the whole frame is already in the buffer
+static uint8_t tx_last(void)
+{
+    return !g_tx_filling;
+}
+
+// called from the uart interrupt when the last byte of the frame was sent
+static void tx_done(void)
+{
+    READ_MODE(g_oe_pin);
+    g_tx_busy = 0;
+
+    if (g_tx_done_cb) g_tx_done_cb();
+}
+
+static void tx_put(uint8_t byte)
+{
+    uint8_t next = (g_tx_head + 1) & TX_BUFFER_MASK;
+
+    // buffer full, waits the interrupt to make room
+    while (next == g_tx_tail)
+    {
+        if (IRQ_DISABLED()) CommSerial.txPoll();
+    }
+
+    g_tx_buffer[g_tx_head] = byte;
+    g_tx_head = next;
+
+    CommSerial.txStart();
+}
+#else
+// writes the staged bytes
+static void tx_flush(void)
+{
+    if (g_tx_count) CommSerial.write(g_tx_buffer, g_tx_count);
+    g_tx_count = 0;
+}
+
+static inline void tx_put(uint8_t byte)
+{
+    g_tx_buffer[g_tx_count++] = byte;
+    if (g_tx_count == CHAIN_TX_BUFFER_SIZE) tx_flush();
+}
+#endif
+
+// escapes the byte and accumulates it on the frame checksum
+static void tx_put_encoded(uint8_t byte)
 {
+    g_tx_checksum += byte;
+
     if (byte == CHAIN_SYNC_BYTE)
     {
-        buffer[0] = CHAIN_ESCAPE_BYTE;
-        buffer[1] = (uint8_t)(~CHAIN_SYNC_BYTE);
-        return 2;
+        tx_put(CHAIN_ESCAPE_BYTE);
+        tx_put((uint8_t)(~CHAIN_SYNC_BYTE));
     }
     else if (byte == CHAIN_ESCAPE_BYTE)
     {
-        buffer[0] = CHAIN_ESCAPE_BYTE;
-        buffer[1] = CHAIN_ESCAPE_BYTE;
-        return 2;
+        tx_put(CHAIN_ESCAPE_BYTE);
+        tx_put(CHAIN_ESCAPE_BYTE);
     }
     else
     {
-        buffer[0] = byte;
-        return 1;
+        tx_put(byte);
     }
+}
 
-    return 0;
+// returns true if the frame destination is one of the local devices
+static inline bool address_accepted(uint8_t address)
+{
+    for (uint8_t i = 0; i < g_addresses_count; i++)
+    {
+        if (g_addresses[i] == 0 || (g_addresses[i] == address && address >= CHAIN_FIRST_DEV_ADDR))
+            return true;
+    }
+
+    return false;
 }
 
 static bool chain_fsm(uint8_t byte) 
@@ -216,7 +569,7 @@ static bool chain_fsm(uint8_t byte)
         case STATE_SYNC:
             if (byte == CHAIN_SYNC_BYTE)
             {
-                g_chain.data_size = 0;
+                g_rx_chain->data_size = 0;
                 received = 0;
                 checksum = CHAIN_SYNC_BYTE;
                 g_fsm_state++;
@@ -224,9 +577,9 @@ static bool chain_fsm(uint8_t byte)
             break;
 
         case STATE_DESTINATION:
-            if (g_address == 0 || (g_address == byte && g_address >= CHAIN_FIRST_DEV_ADDR))
+            if (address_accepted(byte))
             {
-                g_chain.destination = byte;
+                g_rx_chain->destination = byte;
                 g_fsm_state++;
             }
             else
@@ -236,36 +589,44 @@ static bool chain_fsm(uint8_t byte)
             break;
 
         case STATE_ORIGIN:
-            g_chain.origin = byte;
+            g_rx_chain->origin = byte;
             g_fsm_state++;
             break;
 
         case STATE_FUNCTION:
-            g_chain.function = byte;
+            g_rx_chain->function = byte;
             g_fsm_state++;
             break;
 
         case STATE_DATA_SIZE_LSB:
-            g_chain.data_size = byte;
+            g_rx_chain->data_size = byte;
             g_fsm_state++;
             break;
 
         case STATE_DATA_SIZE_MSB:
             tmp = byte;
             tmp <<= 8;
-            g_chain.data_size |= tmp;
+            g_rx_chain->data_size |= tmp;
             g_fsm_state++;
-            if (g_chain.data_size == 0) g_fsm_state++;
+            if (g_rx_chain->data_size == 0) g_fsm_state++;
+
+            // a size that doesn't fit the buffer can only come from a garbled frame
+            if (g_rx_chain->data_size > CHAIN_BUFFER_SIZE)
+            {
+                g_rx_errors++;
+                g_fsm_state = STATE_SYNC;
+            }
             break;
 
         case STATE_DATA:
-            g_chain.data[received++] = byte;
-            if (received == g_chain.data_size) g_fsm_state = STATE_CHECKSUM;
+            g_rx_chain->data[received++] = byte;
+            if (received == g_rx_chain->data_size) g_fsm_state = STATE_CHECKSUM;
             break;
 
         case STATE_CHECKSUM:
             g_fsm_state = STATE_SYNC;
             if (byte == checksum) return true;
+            g_rx_errors++;
             break;
     }
 
@@ -278,18 +639,37 @@ static void byte_recv_cb(uint8_t byte)
 
     // check if is the sync byte before decode it
     // case true, forces the chain fsm to initial state
-    if (byte == CHAIN_SYNC_BYTE) g_fsm_state = STATE_SYNC;
+    if (byte == CHAIN_SYNC_BYTE)
+    {
+        // a frame cut by the start of another one
+        if (g_fsm_state != STATE_SYNC) g_rx_errors++;
+        g_fsm_state = STATE_SYNC;
+    }
 
     if (decode(byte, &byte) && chain_fsm(byte))
     {
-        g_parser_cb(&g_chain);
+#if CHAIN_RX_QUEUE_SIZE
+        // the frame is only published if there is still a free slot to receive the next one
+        if ((uint8_t)(g_rx_head - g_rx_tail) < RX_QUEUE_MASK)
+        {
+            COMPILER_BARRIER();
+            g_rx_head++;
+            g_rx_chain = &g_rx_queue[g_rx_head & RX_QUEUE_MASK];
+        }
+        else
+        {
+            g_rx_overflows++;
+        }
+#else
+        g_parser_cb(g_rx_chain);
+#endif
     }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // global functions definitions
 
-chain_t* comm_init(uint32_t baud_rate, uint8_t oe_pin, void (*parser_cb)(chain_t *chain))
+void comm_init(uint32_t baud_rate, uint8_t oe_pin, void (*parser_cb)(chain_t *chain))
 {
 #ifdef __SAM3X8E__
     // change and update system core clock
@@ -307,49 +687,190 @@ chain_t* comm_init(uint32_t baud_rate, uint8_t oe_pin, void (*parser_cb)(chain_t
 
     g_oe_pin = oe_pin;
     g_parser_cb = parser_cb;
-    g_address = 0;
-
-    return &g_chain;
+    g_addresses[0] = 0;
+    g_addresses_count = 1;
+    g_fsm_state = STATE_SYNC;
+    g_rx_errors = 0;
+
+#if CHAIN_RX_QUEUE_SIZE
+    g_rx_head = 0;
+    g_rx_tail = 0;
+    g_rx_overflows = 0;
+    g_rx_chain = &g_rx_queue[0];
+#endif
 }
 
-void comm_send(chain_t *chain)
+void comm_process(void)
 {
-    uint32_t i;
-    uint8_t *raw_data, checksum = 0;
+    if (!g_parser_cb) return;
 
-    if(chain->origin){
-        g_address = chain->origin;
+    COMM_RX_POLL();
+
+#if CHAIN_RX_QUEUE_SIZE
+    while (g_rx_tail != g_rx_head)
+    {
+        COMPILER_BARRIER();
+        g_parser_cb(&g_rx_queue[g_rx_tail & RX_QUEUE_MASK]);
+        COMPILER_BARRIER();
+        g_rx_tail++;
+
+        COMM_RX_POLL();
     }
+#endif
+}
 
-    chain->sync = CHAIN_SYNC_BYTE;
-    raw_data = (uint8_t *) &(chain->sync);
+uint8_t comm_rx_pending(void)
+{
+#if CHAIN_RX_QUEUE_SIZE
+    return (uint8_t)(g_rx_head - g_rx_tail);
+#else
+    return 0;
+#endif
+}
+
+uint16_t comm_rx_overflows(void)
+{
+#if CHAIN_RX_QUEUE_SIZE
+    uint16_t overflows;
+
+    // 16 bits reads aren't atomic on AVR
+    ENTER_CRITICAL();
+    overflows = g_rx_overflows;
+    EXIT_CRITICAL();
+
+    return overflows;
+#else
+    return 0;
+#endif
+}
+
+uint16_t comm_rx_errors(void)
+{
+    uint16_t errors;
+
+    // 16 bits reads aren't atomic on AVR
+    ENTER_CRITICAL();
+    errors = g_rx_errors;
+    EXIT_CRITICAL();
+
+    return errors;
+}
 
-    // calculate the checksum, 6 is the header size
-    for (i = 0; i < (chain->data_size + 6); i++)
+bool comm_rx_busy(void)
+{
+    return g_fsm_state != STATE_SYNC;
+}
+
+void comm_frame_begin(uint8_t destination, uint8_t origin, uint8_t function, uint16_t data_size)
+{
+#ifdef COMM_TX_IRQ
+    uint8_t idle;
+
+    // a pending end of transmission would turn the bus to read mode in the middle of this frame
+    ENTER_CRITICAL();
+    CommSerial.txCancelDone();
+    idle = !g_tx_busy;
+    g_tx_busy = 1;
+    g_tx_filling = 1;
+    EXIT_CRITICAL();
+
+    if (idle)
     {
-        checksum += *raw_data++;
+        WRITE_MODE(g_oe_pin);
     }
+#else
+    g_tx_busy = 1;
+    WRITE_MODE(g_oe_pin);
+#endif
 
-    // append the checksum to buffer
-    chain->data[chain->data_size] = checksum;
+    // the sync byte is the only one sent without escape
+    tx_put(CHAIN_SYNC_BYTE);
+    g_tx_checksum = CHAIN_SYNC_BYTE;
+    g_tx_remaining = data_size;
 
-    raw_data = (uint8_t *) &(chain->destination);
+    tx_put_encoded(destination);
+    tx_put_encoded(origin);
+    tx_put_encoded(function);
+    tx_put_encoded(data_size & 0xFF);
+    tx_put_encoded(data_size >> 8);
+}
 
-    WRITE_MODE(g_oe_pin);
+void comm_frame_put_u8(uint8_t value)
+{
+    g_tx_remaining--;
+    tx_put_encoded(value);
+}
 
-    // send data
-    uint8_t buffer[2];
-    CommSerial.write(CHAIN_SYNC_BYTE);
-    for (i = 0; i < (chain->data_size + 6); i++)
+void comm_frame_put_u16(uint16_t value)
+{
+    comm_frame_put_u8(value & 0xFF);
+    comm_frame_put_u8(value >> 8);
+}
+
+void comm_frame_put_f32(float value)
+{
+    comm_frame_put_bytes(&value, sizeof(float));
+}
+
+void comm_frame_put_bytes(const void *data, uint16_t size)
+{
+    const uint8_t *raw_data = (const uint8_t *) data;
+
+    g_tx_remaining -= size;
+    while (size--)
     {
-        CommSerial.write(buffer, encode(*raw_data++, buffer));
+        tx_put_encoded(*raw_data++);
     }
+}
+
+bool comm_frame_end(void)
+{
+    bool size_matches = (g_tx_remaining == 0);
+
+    // the checksum itself is escaped but not accumulated
+    uint8_t checksum = g_tx_checksum;
+    tx_put_encoded(checksum);
+
+#ifdef COMM_TX_IRQ
+    // the interrupt switches the bus back to read mode once the buffer is drained
+    g_tx_filling = 0;
+    CommSerial.txStart();
+#else
+    tx_flush();
     READ_MODE(g_oe_pin);
+    g_tx_busy = 0;
+
+    if (g_tx_done_cb) g_tx_done_cb();
+#endif
+
+    return size_matches;
+}
+
+void comm_send(chain_t *chain)
+{
+    chain->sync = CHAIN_SYNC_BYTE;
+
+    comm_frame_begin(chain->destination, chain->origin, chain->function, chain->data_size);
+    comm_frame_put_bytes(chain->data, chain->data_size);
+    comm_frame_end();
 }
 
-void comm_set_address(uint8_t address)
+bool comm_tx_busy(void)
 {
-    g_address = address;
+    return g_tx_busy;
+}
+
+void comm_set_tx_done_cb(void (*tx_done_cb)(void))
+{
+    g_tx_done_cb = tx_done_cb;
+}
+
+void comm_set_address(uint8_t address, uint8_t slot)
+{
+    if (slot >= CHAIN_MAX_ADDRESSES) return;
+
+    g_addresses[slot] = address;
+    if (slot >= g_addresses_count) g_addresses_count = slot + 1;
 }
 
 void comm_print(const char* str)
@@ -5,12 +5,41 @@
 // includes
 #include <stdint.h>
 
+// the application config.h may size the buffers, it must be seen the same way by every file using chain_t
+#if defined(__has_include)
+#if __has_include("config.h")
+#include "config.h"
+#endif
+#endif
+
 // control chain definitions
 #define CHAIN_SYNC_BYTE         0xAA
 #define CHAIN_ESCAPE_BYTE       0x1B
+
+// frames data size, ControlChain checks at compile time that the device messages fit it
+#ifndef CHAIN_BUFFER_SIZE
 #define CHAIN_BUFFER_SIZE       256
+#endif
+
 #define CHAIN_FIRST_DEV_ADDR    0x80
 
+// number of frames buffered between the uart interrupt and comm_process(), must be a power of two
+// one slot is always being received, so the queue holds up to CHAIN_RX_QUEUE_SIZE-1 complete frames
+// if defined as 0 the frames are parsed inside the uart interrupt
+#ifndef CHAIN_RX_QUEUE_SIZE
+#define CHAIN_RX_QUEUE_SIZE     2
+#endif
+
+// number of devices sharing the link, each one has its own address
+#ifndef CHAIN_MAX_ADDRESSES
+#define CHAIN_MAX_ADDRESSES     1
+#endif
+
+// size of the transmit ring buffer drained by the uart interrupt, must be a power of two up to 256
+#ifndef CHAIN_TX_BUFFER_SIZE
+#define CHAIN_TX_BUFFER_SIZE    128
+#endif
+
 
 // data definitions
 typedef struct __attribute__((__packed__)) CHAIN_T {
@@ -22,12 +51,38 @@ typedef struct __attribute__((__packed__)) CHAIN_T {
 
 // functions prototypes
 
-// initializes the communication and returns the receiver struct
-chain_t* comm_init(uint32_t baud_rate, uint8_t oe_pin, void (*parser_cb)(chain_t *chain));
-// receives a chain struct and sends it byte to byte, this function is blocking
+// initializes the communication, received frames are delivered to the parser callback in their own buffers
+void comm_init(uint32_t baud_rate, uint8_t oe_pin, void (*parser_cb)(chain_t *chain));
+// calls the parser callback for each frame queued by the uart interrupt, must be called from the main loop
+void comm_process(void);
+// returns how many received frames are waiting for comm_process()
+uint8_t comm_rx_pending(void);
+// returns how many complete frames were dropped because the receive queue was full
+uint16_t comm_rx_overflows(void);
+// returns how many frames were dropped because they arrived garbled (bad checksum, size or cut by another frame),
+// on a shared bus it's a sign of collisions
+uint16_t comm_rx_errors(void);
+// returns true while a frame is being received
+bool comm_rx_busy(void);
+// receives a chain struct and queues it to be sent by the uart interrupt, the chain can be reused as soon as it
+// returns. It only blocks while the transmit buffer is full
 void comm_send(chain_t *chain);
-// define the address, after defined the communication layer will only accept data coming from the specified address
-void comm_set_address(uint8_t address);
+// streaming frame writer, the fields are escaped and added to the checksum while they are queued to the uart, so
+// no intermediate buffer is used. Frames can't be patched once their first bytes were sent, then data_size must be
+// given in advance. comm_frame_end() appends the checksum and returns false if the data written didn't match data_size
+void comm_frame_begin(uint8_t destination, uint8_t origin, uint8_t function, uint16_t data_size);
+void comm_frame_put_u8(uint8_t value);
+void comm_frame_put_u16(uint16_t value);
+void comm_frame_put_f32(float value);
+void comm_frame_put_bytes(const void *data, uint16_t size);
+bool comm_frame_end(void);
+// returns true while a frame is being sent
+bool comm_tx_busy(void);
+// the callback is called from the uart interrupt when the last byte of a frame leaves the transmitter
+void comm_set_tx_done_cb(void (*tx_done_cb)(void));
+// define the address of the device using the slot, the communication layer only accepts frames sent to the addresses
+// of the slots in use. An address 0 means the device isn't connected yet and makes every frame to be accepted
+void comm_set_address(uint8_t address, uint8_t slot = 0);
 
 void comm_print(const char* str);
 void comm_print(int i);
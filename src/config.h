@@ -1,4 +1,8 @@
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include "hal.h"
+#endif
 
 /*
 ************************************************************************************************************************
@@ -9,16 +13,24 @@ User configurations
 #define MAX_ACTUATORS   3
 #define MAX_ASSIGNMENTS MAX_ACTUATORS + 0   // max number of assignments you can make, summing from all actuators.
 #define VALUE_CHANGE_TOLERANCE 0.01         // min difference between value and old value to consider a change in actuator.
+// #define FIXED_POINT_VALUES                // actuator values in Q16.16 instead of float, for boards without a FPU.
 
-#define MAX_SCALE_POINTS 0                  // limit size of scale point array.
-#define MAX_FLOAT_COUNT MAX_SCALE_POINTS    // limit size of float array.
+#ifndef MAX_SCALE_POINTS
+#define MAX_SCALE_POINTS 0                  // scale points of all assignments, with their values and labels.
+#endif
 
 #define MAX_STRING_SIZE 6                                       // max size of strings used in labels.
-#define MAX_STRING_COUNT MAX_SCALE_POINTS + MAX_ASSIGNMENTS*2   // max number of strings (assignments labels and units + scalepoints).
+#define MAX_STRING_COUNT MAX_ASSIGNMENTS*2                      // max number of strings (assignments labels and units).
 
 #define MAX_MODE_COUNT 10                   // Since modes can be shared between actuators, this is the number of modes contained in the mode_array.
 #define MAX_MODE_LABEL_SIZE MAX_STRING_SIZE // Size limit of mode label.
 
+// the descriptor strings and lists longer than these are cut, the defaults are on actuator.h and device.h
+// #define MAX_NAME_SIZE   16                  // actuator names and device label.
+// #define MAX_URL_SIZE    64                  // device URL.
+// #define MAX_ACTUATOR_MODES 3                // modes of each actuator, Button has 3 and LinearSensor 1.
+// #define MAX_STEPS_COUNT 4                   // steps of each actuator, Button has 1 and LinearSensor 3.
+
 
 /*
 ************************************************************************************************************************
@@ -35,11 +47,9 @@ Arduino related
 #ifdef ARDUINO
 #define SET_PIN_MODE(pin, mode)         pinMode(pin, mode)
 #define DIGITAL_WRITE(pin, value)       digitalWrite(pin, value)
-#define RANDOM_FUNCTION(bottom, top)    random(bottom, top)
 #else
 #define SET_PIN_MODE(pin, mode)
 #define DIGITAL_WRITE(pin, value)
-#define RANDOM_FUNCTION(bottom, top)    10
 #endif
 
 #if  DEBUG_FLAG
@@ -71,3 +81,9 @@ serial configuration
 // #define BAUD_RATE       1000000
 
 #define WRITE_READ_PIN  2
+
+// frames data size, it must hold the biggest message (the build fails otherwise). Lower it on small boards.
+// #define CHAIN_BUFFER_SIZE   256
+
+// descriptors and data request responses bigger than this are sent in fragments, it must be lower than CHAIN_BUFFER_SIZE.
+// #define FRAGMENT_SIZE       128
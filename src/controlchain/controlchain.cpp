@@ -1,29 +1,43 @@
 #include "controlchain.h"
 
-void conversionOutput(uint8_t* buff){
-    comm_send((chain_t*) buff);
-}
+// The messages sent by the device and the assignments it receives must fit the frames buffer. If the build fails here
+// lower the limits on config.h (or FRAGMENT_SIZE) or raise CHAIN_BUFFER_SIZE, if it's too big it can be lowered to save
+// memory.
+static_assert(MESSAGE_MAX_SIZE <= CHAIN_BUFFER_SIZE, "Device messages don't fit CHAIN_BUFFER_SIZE.");
+static_assert(CONTROL_ASSIGNMENT_MAX_SIZE <= CHAIN_BUFFER_SIZE, "Control assignments don't fit CHAIN_BUFFER_SIZE.");
+
+ControlChain* g_chain;
 
-Device* g_dev;
+// the device messages are escaped and checksummed while they are written on the transmit buffer.
+static const frame_writer_t comm_writer = {
+    comm_frame_begin, comm_frame_put_u8, comm_frame_put_bytes, comm_frame_end
+};
 
 void conversionInput(chain_t* buff){
-    g_dev->parse((uint8_t*) buff);
+    g_chain->route(buff);
+}
+
+// the devices addresses change when they connect or time out, so they are updated before the frames are received.
+void pollInput(){
+    g_chain->updateAddresses();
+    comm_process();
 }
 
 void isr_timer(){
     STimer::clock();
 }
 
-ControlChain::ControlChain(){}
+ControlChain::ControlChain(){
+    this->dev = 0;
+    this->devs_count = 0;
+}
 ControlChain::~ControlChain(){}
 
 void ControlChain::init(Device* dev){
-    this->dev = dev;
-    g_dev = dev;
-    this->chain = comm_init(BAUD_RATE, WRITE_READ_PIN, conversionInput);
+    g_chain = this;
+    comm_init(BAUD_RATE, WRITE_READ_PIN, conversionInput);
 
-    this->dev->setOutBuffer((uint8_t*)this->chain);
-    this->dev->setCallback(conversionOutput);
+    addDevice(dev);
 
 
     // These ifdefs switches between AVR and ARM compatible timers
@@ -39,4 +53,74 @@ void ControlChain::init(Device* dev){
     Timer1.attachInterrupt(isr_timer);
     #endif
 
-}
\ No newline at end of file
+    #ifndef ARDUINO
+    hal_timer_attach(isr_timer);
+    #endif
+
+}
+
+bool ControlChain::addDevice(Device* dev){
+    if(this->devs_count >= CHAIN_MAX_ADDRESSES){
+        return false;
+    }
+
+    if(!this->devs_count){
+        this->dev = dev;
+    }
+    this->devs[this->devs_count++] = dev;
+
+    // the devices share the transmit buffer, messages are sent while they are built.
+    dev->setWriter(&comm_writer);
+    dev->setPollCallback(pollInput);
+    dev->setBusCallbacks(comm_rx_busy, comm_rx_errors);
+
+    updateAddresses();
+
+    return true;
+}
+
+void ControlChain::route(chain_t* frame){
+    Device* connecting = 0;
+
+    // a connection response goes to the connecting device with the same URL and channel, if there is none the
+    // first connecting device answers it with an error.
+    if(frame->function == FUNC_CONNECTION){
+        // url size (1) + url (n) + channel (1) must be within the frame before the url is compared.
+        if(!frame->data_size || frame->data[0] + 1 + 1 > frame->data_size)
+            return;
+
+        for (int i = 0; i < devs_count; ++i){
+            if(devs[i]->state != CONNECTING)
+                continue;
+
+            if(devs[i]->matchConnection((uint8_t*) frame)){
+                connecting = devs[i];
+                break;
+            }
+
+            if(!connecting)
+                connecting = devs[i];
+        }
+
+        if(connecting){
+            connecting->parse((uint8_t*) frame);
+            updateAddresses();
+        }
+        return;
+    }
+
+    for (int i = 0; i < devs_count; ++i){
+        if(devs[i]->state != CONNECTING && devs[i]->id == frame->destination){
+            devs[i]->parse((uint8_t*) frame);
+            return;
+        }
+    }
+
+    // frames to other addresses are only accepted while some device is connecting, which would ignore them anyway.
+}
+
+void ControlChain::updateAddresses(){
+    for (int i = 0; i < devs_count; ++i){
+        comm_set_address(devs[i]->state == CONNECTING ? 0 : devs[i]->id, i);
+    }
+}
@@ -5,17 +5,40 @@
 #include "comm.h"
 #include "device.h"
 
+#ifdef ARDUINO_ARCH_AVR
 #include "TimerOne.h"
+#endif
+
+#ifdef ARDUINO_ARCH_SAM
 #include "DueTimer.h"
+#endif
 
+/*
+************************************************************************************************************************
+This class links the devices to the communication layer. Up to CHAIN_MAX_ADDRESSES devices share the same uart, each
+one with its own URL/channel and address, the received frames are routed to the device they are sent to.
+************************************************************************************************************************
+*/
 class ControlChain{
 public:
-    Device* dev;
-    chain_t* chain;
+    Device* dev;                            // first device added
+    Device* devs[CHAIN_MAX_ADDRESSES];
+    uint8_t devs_count;
 
     ControlChain();
     ~ControlChain();
+
+    // initializes the communication and adds the first device.
     void init(Device* dev);
+
+    // adds another device to the link, returns false if there are already CHAIN_MAX_ADDRESSES devices.
+    bool addDevice(Device* dev);
+
+    // routes a received frame to the device it is sent to.
+    void route(chain_t* frame);
+
+    // updates the addresses accepted by the communication layer with the devices ones.
+    void updateAddresses();
 };
 
 #endif
\ No newline at end of file
@@ -1,4 +1,9 @@
 #include "device.h"
+#include <string.h>
+
+static_assert(UPDATES_PER_FRAME >= 1, "FRAGMENT_SIZE can't hold an update.");
+static_assert(1 + MAX_BULK_ASSIGNMENTS <= MAX_REPLY_SIZE, "Bulk assignment response doesn't fit MAX_REPLY_SIZE.");
+static_assert((DESCRIPTOR_MAX_SIZE + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE <= 255, "Too many descriptor fragments, raise FRAGMENT_SIZE.");
 
 bool stringComp(const char* str1, uint8_t str1_size, const char* str2, uint8_t str2_size){
     if(str1_size == str2_size){
@@ -15,26 +20,78 @@ bool stringComp(const char* str1, uint8_t str1_size, const char* str2, uint8_t s
 Device::Device(const char* url_id, const char* label, uint8_t channel){
 
     this->label = label;
-    for (label_size = 0; label[label_size]; ++label_size);
+    for (label_size = 0; label[label_size] && label_size < MAX_NAME_SIZE; ++label_size);
 
     this->url_id = url_id;
-    for (url_size = 0; url_id[url_size]; ++url_size);
+    for (url_size = 0; url_id[url_size] && url_size < MAX_URL_SIZE; ++url_size);
 
     this->id = 0;
     this->channel = channel;
 
     this->act_counter = 0;
     this->num_actuators = MAX_ACTUATORS;
+    this->sample_next = 0;
+
+    this->descriptor_size = 0;
+    this->descriptor_valid = false;
+    this->descriptor_cached = false;
+    this->descriptor_modes = 0;
 
     for (int i = 0; i < num_actuators; ++i){
         acts[i] = 0;
     }
 
+    for (int i = 0; i < DIRTY_WORDS; ++i){
+        dirty[i] = 0;
+        batch[i] = 0;
+        pushed[i] = 0;
+    }
+    this->batch_fragments = 0;
+    this->assig_requests_count = 0;
+
+    this->user_functions_count = 0;
+
+    for (int i = 0; i < ID_TABLE_SIZE; ++i){
+        act_index[i] = 0;
+        assig_act[i] = 0;
+        assig_slot[i] = 0;
+    }
+
     this->state = CONNECTING;
+    this->resume_state = CONNECTING;
+    this->generation = 0;
+    this->push_enabled = false;
+    this->push_period = 0;
+    this->push_offset = 0;
+    this->push_length = 0;
+    this->push_anchor = 0;
+    this->push_window = 0;
+    this->value_encoding = VALUE_ENCODING_FLOAT;
+    this->connecting_timer_set = false;
+    this->connect_attempts = 0;
+    this->bus_errors = 0;
+    this->led_state = 0;
+
+    // FNV-1a hash of URL and channel, identical devices are told apart by the channel
+    this->random_state = 2166136261u;
+    for (int i = 0; i < url_size; ++i){
+        this->random_state = (this->random_state ^ (uint8_t) url_id[i]) * 16777619u;
+    }
+    this->random_state = (this->random_state ^ channel) * 16777619u;
+    if(!this->random_state){
+        this->random_state = 1;
+    }
+
+    this->writer = 0;
+    this->msg_poll_cb = 0;
+    this->bus_busy_cb = 0;
+    this->bus_errors_cb = 0;
 
     timer_led.setPeriod(CONNECTING_LED_PERIOD);
     timer_led.start();
 
+    timer_timeout.setPeriod(DEVICE_TIMEOUT_PERIOD);
+
     SET_PIN_MODE(USER_LED, OUTPUT); //ard
 }
 
@@ -43,18 +100,26 @@ Device::~Device(){}
 void Device::init(){
     for (int i = 0; i < act_counter; ++i){
         acts[i]->init();
+
+        timer_sample[i].setPeriod(acts[i]->sample_period);
+        timer_sample[i].start();
     }
+
+    // actuators may have their assignment slots reduced on init, which is part of the descriptor.
+    updateDescriptor();
+}
+
+void Device::setWriter(const frame_writer_t* writer){
+    this->writer = writer;
 }
 
-void Device::setCallback(void (*msg_ready_cb)(uint8_t* in_buff)){
-    this->msg_ready_cb = msg_ready_cb;
+void Device::setPollCallback(void (*msg_poll_cb)(void)){
+    this->msg_poll_cb = msg_poll_cb;
 }
 
-void Device::setOutBuffer(uint8_t* message_out){
-    this->message_out = message_out;
-    this->message_out[POS_SYNC] = BYTE_SYNC;
-    this->message_out[POS_DEST] = HOST_ADDRESS;
-    this->message_out[POS_ORIG] = this->id;
+void Device::setBusCallbacks(bool (*bus_busy_cb)(void), uint16_t (*bus_errors_cb)(void)){
+    this->bus_busy_cb = bus_busy_cb;
+    this->bus_errors_cb = bus_errors_cb;
 }
 
 /*
@@ -63,15 +128,46 @@ void Device::setOutBuffer(uint8_t* message_out){
 ************************************************************************************************************************
 */
 
+// takes the device back to connecting, keeping the actuators assignments to be resumed.
 void Device::timeoutReset(){
+    this->resume_state = this->state;
     this->state = CONNECTING;
+
+    // the host may give another address, until then frames to any address are accepted.
+    this->id = 0;
+
+    // the pushes not acknowledged go on the first data request after the reconnection. push mode and the value
+    // encoding are kept in case the host resumes this generation, nothing is pushed until then.
+    for (int w = 0; w < DIRTY_WORDS; ++w){
+        dirty[w] |= pushed[w];
+        pushed[w] = 0;
+    }
+    timer_timeout.stop();
     timer_led.start();
+
+    this->connect_attempts = 0;
+    this->connecting_timer_set = false;
+}
+
+// calls timeoutReset() if no frame was received from the host for DEVICE_TIMEOUT_PERIOD.
+void Device::checkTimeout(){
+#if DEVICE_TIMEOUT_PERIOD
+    if(this->state != CONNECTING && timer_timeout.check()){
+        timeoutReset();
+    }
+#endif
 }
 
 // adds an actuator pointer to the pointer vector.
 void Device::addActuator(Actuator* act){
     if(act_counter < num_actuators){
+        // in case of repeated ids, the first actuator added is the one found.
+        if(act->id < ID_TABLE_SIZE && !act_index[act->id]){
+            act_index[act->id] = act_counter + 1;
+        }
+
         acts[act_counter++] = act;
+        this->descriptor_valid = false;
     }
     else{
         ERROR("Actuators limit overflow!");
@@ -81,6 +177,10 @@ void Device::addActuator(Actuator* act){
 // receives actuator id (not necessarily equal to actuator's index on acts[]) and returns a pointer to that actuator
 Actuator* Device::searchActuator(int id){
 
+    if(id >= 0 && id < ID_TABLE_SIZE){
+        return act_index[id] ? acts[act_index[id] - 1] : 0;
+    }
+
     for (int i = 0; i < act_counter; ++i){
         if(acts[i]){
             if(acts[i]->id == id){
@@ -91,307 +191,777 @@ Actuator* Device::searchActuator(int id){
     return 0;
 }
 
-// runs value calculation function on actuator class (or sub class)
+// frees the assignment with the given id, whichever actuator holds it.
+bool Device::unassign(uint8_t assignment_id){
+    bool ret = false;
+
+    if(assignment_id < ID_TABLE_SIZE){
+        if(assig_act[assignment_id]){
+            ret = assig_act[assignment_id]->unassign(assig_slot[assignment_id]);
+
+            assig_act[assignment_id] = 0;
+            assig_slot[assignment_id] = 0;
+        }
+        return ret;
+    }
+
+    for (int i = 0; i < act_counter; ++i){
+        if(acts[i]->unassign(assignment_id)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// frees all assignments of all actuators.
+void Device::unassignAll(){
+    for (int i = 0; i < act_counter; ++i){
+        while(acts[i]->unassign(acts[i]->current_assig));
+    }
+
+    for (int i = 0; i < ID_TABLE_SIZE; ++i){
+        assig_act[i] = 0;
+        assig_slot[i] = 0;
+    }
+
+    for (int i = 0; i < DIRTY_WORDS; ++i){
+        dirty[i] = 0;
+        pushed[i] = 0;
+    }
+    this->batch_fragments = 0;
+}
+
+// changes the assignment slots of an actuator at runtime, the host reads them on the next descriptor.
+bool Device::setAssignmentSlots(Actuator* act, uint8_t count){
+    bool ret = act->setAssignmentSlots(count);
+
+    this->descriptor_valid = false;
+    return ret;
+}
+
+// asks the host to send the assignment with the given id, the ids go on the next data request response only once.
+bool Device::requestAssignment(uint8_t assignment_id){
+    for (int i = 0; i < assig_requests_count; ++i){
+        if(assig_requests[i] == assignment_id){
+            return true;
+        }
+    }
+
+    if(assig_requests_count >= MAX_ASSIGNMENT_REQUESTS){
+        return false;
+    }
+
+    assig_requests[assig_requests_count++] = assignment_id;
+    return true;
+}
+
+// runs value calculation function on the actuators whose sample period expired, at most SAMPLE_BUDGET of them,
+// and marks the ones that changed as dirty
 void Device::refreshValues(){
+    int budget = SAMPLE_BUDGET;
+
+    // the round starts after the last actuator sampled, so the ones left out by the budget are the first next time.
+    for (int n = 0; n < act_counter && budget; ++n){
+        int i = sample_next;
+        sample_next = (i + 1 < act_counter) ? i + 1 : 0;
+
+        // a due timer is only checked (and restarted) when the actuator is sampled, the ones skipped stay due.
+        if(!acts[i]->assignments_occupied || !timer_sample[i].check()){
+            continue;
+        }
+
+        budget--;
+        acts[i]->calculateValue();
+
+        if(acts[i]->checkChange()){
+            dirty[i / 32] |= (uint32_t) 1 << (i % 32);
+        }
+    }
+}
+
+// serializes the device descriptor on the cache and updates its size.
+void Device::updateDescriptor(){
+    // labelsize (1) + label(n) + num_actuators(n) + num_actuators(n) * actuators_description_sizes(n)
+    this->descriptor_size = 1 + this->label_size + 1;
     for (int i = 0; i < act_counter; ++i){
-        if(acts[i]->assignments_occupied){
-            acts[i]->calculateValue();
+        this->descriptor_size += acts[i]->descriptorSize();
+    }
+
+    this->descriptor_cached = (this->descriptor_size <= DESCRIPTOR_CACHE_SIZE);
+    if(this->descriptor_cached){
+        writeDescriptor(this->descriptor);
+    }
+
+    this->descriptor_modes = Mode::modes_occupied;
+    this->descriptor_valid = true;
+}
+
+// writes the device descriptor on buffer, returns the number of written bytes.
+int Device::writeDescriptor(uint8_t* buffer){
+    int i = 0;
+
+    buffer[i++] = this->label_size;
+
+    for (int j = 0; j < label_size; ++j){
+        buffer[i++] = this->label[j];
+    }
+
+    buffer[i++] = this->act_counter;
+
+    for(int j = 0; j < act_counter; j++){
+        i += this->acts[j]->getDescriptor(&buffer[i]);
+    }
+
+    return i;
+}
+
+// puts size bytes of the device descriptor from offset on the frame writer.
+void Device::putDescriptor(uint16_t offset, uint16_t size){
+    uint8_t piece[MAX_OF(ACTUATOR_DESCRIPTOR_MAX_SIZE, 2 + MAX_NAME_SIZE)];
+    uint16_t start = 0, from, piece_size, n;
+    uint16_t written = 0;
+
+    if(offset >= this->descriptor_size){
+        return;
+    }
+
+    if(size > this->descriptor_size - offset){
+        size = this->descriptor_size - offset;
+    }
+
+    if(this->descriptor_cached){
+        this->writer->put(&this->descriptor[offset], size);
+        return;
+    }
+
+    // the label is the first piece (j = -1), each actuator descriptor is another one. The pieces before offset are
+    // skipped by their size.
+    for (int j = -1; j < act_counter && written < size; ++j){
+        piece_size = (j < 0) ? 2 + this->label_size : acts[j]->descriptorSize();
+
+        if(start + piece_size > offset){
+            if(j < 0){
+                piece[0] = this->label_size;
+                memcpy(&piece[1], this->label, this->label_size);
+                piece[1 + this->label_size] = this->act_counter;
+            }
+            else{
+                acts[j]->getDescriptor(piece);
+            }
+
+            from = (offset > start) ? offset - start : 0;
+            n = piece_size - from;
+            if(n > size - written){
+                n = size - written;
+            }
+
+            this->writer->put(&piece[from], n);
+            written += n;
         }
+
+        start += piece_size;
     }
 }
 
+// number of fragments the descriptor is sent in, 1 if it fits FRAGMENT_SIZE.
+uint8_t Device::descriptorFragments(){
+    if(!this->descriptor_valid || this->descriptor_modes != Mode::modes_occupied){
+        updateDescriptor();
+    }
+
+    return this->descriptor_size ? (this->descriptor_size + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE : 1;
+}
+
 /*
 ************************************************************************************************************************
 *           Communication Related
 ************************************************************************************************************************
 */
+// Protocol functions accepted by the device, indexed by function code. A function arriving in a state not listed in
+// its mask is answered with the entry error, except while connecting, when the device has no address yet.
+static const function_t builtin_functions[BUILTIN_FUNCTIONS_COUNT] = {
+    {0, 0, 0, 0, 0},
+    {FUNC_CONNECTION, STATE_BIT(CONNECTING), "Device already connected.",
+        &Device::parseConnection, 0},
+    {FUNC_DEVICE_DESCRIPTOR, STATE_BIT(WAITING_DESCRIPTOR_REQUEST) | STATE_BIT(WAITING_DATA_REQUEST), "Not waiting descriptor request.",
+        &Device::parseDescriptorRequest, 0},
+    {FUNC_CONTROL_ASSIGNMENT, STATE_BIT(WAITING_CONTROL_ASSIGNMENT) | STATE_BIT(WAITING_DATA_REQUEST), "Not waiting control assignment.",
+        &Device::parseControlAssignment, 0},
+    {FUNC_DATA_REQUEST, STATE_BIT(WAITING_DATA_REQUEST), "Not waiting data request.",
+        &Device::parseDataRequest, 0},
+    {FUNC_CONTROL_UNASSIGNMENT, STATE_BIT(WAITING_DATA_REQUEST), "No control assigned.",
+        &Device::parseControlUnassignment, 0},
+    {FUNC_PUSH_MODE, STATE_BIT(WAITING_CONTROL_ASSIGNMENT) | STATE_BIT(WAITING_DATA_REQUEST), "Device not ready to push.",
+        &Device::parsePushMode, 0},
+    {FUNC_DATA_PUSH, STATE_BIT(WAITING_DATA_REQUEST), "Not waiting data request.",
+        &Device::parsePushAck, 0},
+    {FUNC_DESCRIPTOR_FRAGMENT, STATE_BIT(WAITING_DESCRIPTOR_REQUEST) | STATE_BIT(WAITING_CONTROL_ASSIGNMENT) | STATE_BIT(WAITING_DATA_REQUEST),
+        "Not waiting descriptor request.", &Device::parseDescriptorFragment, 0},
+    {FUNC_DATA_FRAGMENT, STATE_BIT(WAITING_DATA_REQUEST), "Not waiting data request.",
+        &Device::parseDataFragment, 0},
+    {FUNC_VALUE_ENCODING, STATE_BIT(WAITING_CONTROL_ASSIGNMENT) | STATE_BIT(WAITING_DATA_REQUEST), "Device not ready.",
+        &Device::parseValueEncoding, 0},
+    {FUNC_BULK_ASSIGNMENT, STATE_BIT(WAITING_CONTROL_ASSIGNMENT) | STATE_BIT(WAITING_DATA_REQUEST), "Not waiting control assignment.",
+        &Device::parseBulkAssignment, 0},
+};
+
+// registers a handler to a function code not used by the protocol, states is a mask made with STATE_BIT.
+bool Device::registerFunction(uint8_t function, uint8_t states, function_handler_t handler){
+    if(function < BUILTIN_FUNCTIONS_COUNT || function == FUNC_ERROR || !handler){
+        return false;
+    }
+
+    for (int i = 0; i < user_functions_count; ++i){
+        if(user_functions[i].function == function){
+            user_functions[i].states = states;
+            user_functions[i].user_handler = handler;
+            return true;
+        }
+    }
+
+    if(user_functions_count >= MAX_USER_FUNCTIONS){
+        return false;
+    }
+
+    function_t* entry = &user_functions[user_functions_count++];
+    entry->function = function;
+    entry->states = states;
+    entry->state_error = "Function not allowed now.";
+    entry->handler = 0;
+    entry->user_handler = handler;
+
+    return true;
+}
+
 // This function parses the data field (mainly) on a received message, it takes care of all the functions from protocol
-// receives an output parameter (message_out) where it will write the response message.
+// and writes the response message on the frame writer.
 void Device::parse(uint8_t* message_in){
+    uint8_t function = message_in[POS_FUNC];
+    const function_t* entry = 0;
 
-    // connection response, checks URL and channel to associate address to device id.
-    if(this->state == CONNECTING){
-        if(message_in[POS_FUNC] == FUNC_CONNECTION){
+    if(function < BUILTIN_FUNCTIONS_COUNT){
+        entry = &builtin_functions[function];
+    }
+    else{
+        for (int i = 0; i < user_functions_count; ++i){
+            if(user_functions[i].function == function){
+                entry = &user_functions[i];
+                break;
+            }
+        }
+    }
+
+    if(!entry || !entry->states){
+        return;
+    }
+
+    // any frame from the host keeps the link alive.
+    if(this->state != CONNECTING){
+        timer_timeout.start();
+    }
+
+    if(!(entry->states & STATE_BIT(this->state))){
+        if(this->state != CONNECTING){
+            ERROR(entry->state_error);
+        }
+        return;
+    }
 
+    if(entry->handler)
+        (this->*(entry->handler))(message_in);
+    else
+        entry->user_handler(this, message_in);
+}
 
-            uint16_t* data_size;
-            data_size = (uint16_t*) &message_in[POS_DATA_SIZE1];
+// checks if a connection response has this device URL and channel.
+bool Device::matchConnection(uint8_t* message_in){
+    uint8_t url_size = message_in[POS_DATA_SIZE2+1];
 
-            if( stringComp((const char*)&message_in[POS_DATA_SIZE2+2] , message_in[POS_DATA_SIZE2+1], this->url_id, this->url_size) && (message_in[*data_size+3] == this->channel) ){
+    return stringComp((const char*)&message_in[POS_DATA_SIZE2+2] , url_size, this->url_id, this->url_size) &&
+        (message_in[POS_DATA_SIZE2 + 2 + url_size] == this->channel);
+}
 
-                this->id = message_in[POS_DEST];
-                this->message_out[POS_ORIG] = this->id;
-                this->state = WAITING_DESCRIPTOR_REQUEST;
+// connection response, checks URL and channel to associate address to device id.
+// url size (1) + url (n) + channel (1) + version (2) + generation (2, optional)
+void Device::parseConnection(uint8_t* message_in){
+    uint16_t* data_size;
+    data_size = (uint16_t*) &message_in[POS_DATA_SIZE1];
 
-                return;
-            }
-            else{
-                ERROR("URL or Channel doesn't match.");
-                return;
-            }
+    uint8_t url_size = message_in[POS_DATA_SIZE2+1];
+    int channel_pos = POS_DATA_SIZE2 + 2 + url_size;
+    uint16_t token = 0;
+
+    if(matchConnection(message_in)){
+
+        this->id = message_in[POS_DEST];
+
+        if(*data_size >= url_size + 6){
+            token = message_in[channel_pos+3] | (message_in[channel_pos+4] << 8);
+        }
+
+        // the host still holds the descriptor and the assignments made with this token, skip straight to where the
+        // device was when the link was lost.
+        this->connect_attempts = 0;
+
+        if(token && token == this->generation && this->resume_state >= WAITING_CONTROL_ASSIGNMENT){
+            this->state = this->resume_state;
+        }
+        else{
+            unassignAll();
+            this->push_enabled = false;
+            this->value_encoding = VALUE_ENCODING_FLOAT;
+            this->generation = token;
+            this->state = WAITING_DESCRIPTOR_REQUEST;
         }
-        else
-            return;
+
+        timer_timeout.start();
     }
     else{
+        ERROR("URL or Channel doesn't match.");
+    }
+}
+
+// returns device descriptor, if it's bigger than FRAGMENT_SIZE the first fragment is sent and the host asks the others.
+void Device::parseDescriptorRequest(uint8_t* message_in){
+    (void) message_in;
 
-        switch(message_in[POS_FUNC]){
+    if(descriptorFragments() > 1){
+        // the descriptor is only taken as read after its last fragment is sent, see parseDescriptorFragment.
+        this->state = WAITING_DESCRIPTOR_REQUEST;
+        sendMessage(FUNC_DESCRIPTOR_FRAGMENT, 0);
+    }
+    else{
+        sendMessage(FUNC_DEVICE_DESCRIPTOR);
+        this->state = WAITING_CONTROL_ASSIGNMENT;
+    }
+}
 
-            // if already connected and debug flag is on, an error message is sent on serial connection.
-            case FUNC_CONNECTION:
-                ERROR("Device already connected.");
-            break;
+void Device::parseControlAssignment(uint8_t* message_in){
+    switch(assignControl(&message_in[CTRLADDR_ACT_ID])){
+        case ASSIGN_OK:
+            sendMessage(FUNC_CONTROL_ASSIGNMENT, 0);
+            this->state = WAITING_DATA_REQUEST;
+        break;
 
-            // returns device descriptor
-            case FUNC_DEVICE_DESCRIPTOR:
-                if(this->state != WAITING_DESCRIPTOR_REQUEST && this->state != WAITING_DATA_REQUEST){
-                    ERROR("Not waiting descriptor request.");
-                }
-                else{
-                    sendMessage(FUNC_DEVICE_DESCRIPTOR);
-                    this->state = WAITING_CONTROL_ASSIGNMENT;
+        case ASSIGN_NO_ACTUATOR:
+            ERROR("Actuator does not exist.");
+        break;
 
-                }
-            break;
+        case ASSIGN_MODE_NOT_SUPPORTED:
+            ERROR("Mode not supported in this actuator.");
+            sendMessage(FUNC_CONTROL_ASSIGNMENT, -1);
+        break;
 
-            case FUNC_CONTROL_ASSIGNMENT:
+        case ASSIGN_SLOTS_FULL:
+            ERROR("Maximum parameters addressed already.");
+        break;
 
+        default:
+            sendMessage(FUNC_CONTROL_ASSIGNMENT, -1);
+    }
+}
 
-                if(this->state != WAITING_CONTROL_ASSIGNMENT && this->state != WAITING_DATA_REQUEST){
-                    ERROR("Not waiting control assignment.");
-                }
-                else{
+// assignments count (1) + assignments (n), each one laid out as a control assignment message data. The response holds
+// the count and the status of each assignment (1 byte each), the ones after a malformed assignment aren't made.
+void Device::parseBulkAssignment(uint8_t* message_in){
+    uint16_t data_size = message_in[POS_DATA_SIZE1] | (message_in[POS_DATA_SIZE2] << 8);
+    uint8_t count = message_in[POS_DATA_SIZE2+1];
+    uint8_t reply[1 + MAX_BULK_ASSIGNMENTS];
+    uint16_t idx = 1, record_size;
+    int8_t status;
+
+    if(!data_size || count > MAX_BULK_ASSIGNMENTS){
+        ERROR("Too many assignments.");
+        return;
+    }
 
-                    Actuator* act;
+    reply[0] = count;
 
-                    // Since actuator ID and index on the vector 'acts' are not necessarily the same, this function returns a pointer to
-                    // the ID placed as parameter.
-                    act = searchActuator(message_in[CTRLADDR_ACT_ID]);
-                    if(!(act)){
-                        ERROR("Actuator does not exist.");
-                        return;
-                    }
-                    // In case the pointer is not NULL.
-                    else{
-
-                        // Checks if the mode is not supported on the device.
-                        if(!(act->supportMode(message_in[CTRLADDR_CHOSEN_MASK1], message_in[CTRLADDR_CHOSEN_MASK2]))){
-
-                            ERROR("Mode not supported in this actuator.");
-                            sendMessage(FUNC_CONTROL_ASSIGNMENT, -1);
-                            return;
-                        }
-                        // Checks if the parameter has no slots to contain the parameter.
-                        if(act->assignments_occupied >= act->num_assignments){
-                            ERROR("Maximum parameters addressed already.");
-                            return;
-                        }
-                        // if everything is ok, the parameter is assigned to the actuator.
-                        else{
-                            if( act->assign( &(message_in[CTRLADDR_ACT_ID+1]) ) ){
-                                sendMessage(FUNC_CONTROL_ASSIGNMENT, 0);
-                                this->state = WAITING_DATA_REQUEST;
-                            }
-                            else{
-                                sendMessage(FUNC_CONTROL_ASSIGNMENT, -1);
-                            }
-                        }
-                    }
+    for (int i = 0; i < count; ++i){
+        const uint8_t* record = &message_in[POS_DATA_SIZE2 + 1 + idx];
 
-                }
-            break;
+        // actuator id (1) + the assignment record
+        record_size = (idx < data_size) ? Assignment::recordSize(record + 1, data_size - idx - 1) : 0;
 
-            case FUNC_DATA_REQUEST:
+        if(!record_size){
+            status = ASSIGN_MALFORMED;
+            idx = data_size;
+        }
+        else{
+            status = assignControl(record);
+            idx += 1 + record_size;
+        }
 
-                // checks if the state is not propper to send a data request message.
-                if(this->state != WAITING_DATA_REQUEST){
-                    ERROR("Not waiting data request.");
-                    return;
-                }
-                else{
-                    sendMessage(FUNC_DATA_REQUEST);
-                }
+        if(status == ASSIGN_OK){
+            this->state = WAITING_DATA_REQUEST;
+        }
 
-            break;
+        reply[1 + i] = status;
+    }
 
-            // this function empty the assignment slot on a parameter, in case it has a parameter assigned.
-            case FUNC_CONTROL_UNASSIGNMENT:
+    sendReply(FUNC_BULK_ASSIGNMENT, reply, 1 + count);
+}
 
+// assigns a control from record, laid out as a control assignment message data. Returns an ASSIGN_ status.
+int8_t Device::assignControl(const uint8_t* record){
+    Actuator* act;
+    uint8_t assig_id = record[CTRLADDR_ADDR_ID - CTRLADDR_ACT_ID];
 
-                if(this->state != WAITING_DATA_REQUEST){
-                    ERROR("No control assigned.");
-                    return;
-                }
-                else{
-                    for (int i = 0; i < act_counter; ++i){
-                        if(acts[i]->unassign(message_in[UNASSIG_ACT_ID])){
-                            sendMessage(FUNC_CONTROL_UNASSIGNMENT);
-                            return;
-                        }
-                    }
-                }
-            break;
+    // Since actuator ID and index on the vector 'acts' are not necessarily the same, this function returns a pointer to
+    // the ID placed as parameter.
+    act = searchActuator(record[0]);
+    if(!(act)){
+        return ASSIGN_NO_ACTUATOR;
+    }
+
+    // Checks if the mode is not supported on the device.
+    if(!(act->supportMode(record[CTRLADDR_CHOSEN_MASK1 - CTRLADDR_ACT_ID], record[CTRLADDR_CHOSEN_MASK2 - CTRLADDR_ACT_ID]))){
+        return ASSIGN_MODE_NOT_SUPPORTED;
+    }
+
+    // an id already in use is reassigned, its old slot is freed first so it isn't leaked.
+    if(assig_id < ID_TABLE_SIZE && assig_act[assig_id]){
+        unassign(assig_id);
+    }
+
+    // Checks if the parameter has no slots to contain the parameter.
+    if(act->assignments_occupied >= act->num_assignments){
+        return ASSIGN_SLOTS_FULL;
+    }
+
+    // if everything is ok, the parameter is assigned to the actuator.
+    if(act->assign(&record[1])){
+        // the assigned slot is now the actuator current assignment.
+        if(assig_id < ID_TABLE_SIZE){
+            assig_act[assig_id] = act;
+            assig_slot[assig_id] = act->current_assig;
+        }
+
+        // the host sent it before the request went out.
+        for (int i = 0; i < assig_requests_count; ++i){
+            if(assig_requests[i] == assig_id){
+                assig_requests[i] = assig_requests[--assig_requests_count];
+                break;
+            }
         }
+
+        return ASSIGN_OK;
     }
+
+    return ASSIGN_FAILED;
 }
 
-// Its responsible for sending all messages, but don´t send them, it calls another function (send) which will handle that.
-// The integer returned in this function indicates if the message was sent or not.
-int Device::sendMessage(uint8_t function, int16_t status, const char* error_msg){
+// when more actuators changed than a frame holds, they are kept as a batch sent in fragments, the first one goes now.
+// The pushes not acknowledged yet go again, the host may poll because it missed them.
+void Device::parseDataRequest(uint8_t* message_in){
+    int changed = 0;
+    (void) message_in;
 
-    int i;
-    int msg_idx = POS_DEST;
+    for (int w = 0; w < DIRTY_WORDS; ++w){
+        dirty[w] |= pushed[w];
+        pushed[w] = 0;
+        changed += __builtin_popcountl(dirty[w]);
+    }
 
-    int error_size;
-    int changed_actuators = 0;
-    static uint16_t data_size=0;
-    static uint8_t* byte_ptr=0;
+    if(changed > UPDATES_PER_FRAME){
+        memcpy(this->batch, this->dirty, sizeof(this->batch));
+        this->batch_fragments = (changed + UPDATES_PER_FRAME - 1) / UPDATES_PER_FRAME;
 
+        sendMessage(FUNC_DATA_FRAGMENT, 0);
+    }
+    else{
+        sendMessage(FUNC_DATA_REQUEST);
+    }
+}
 
-    switch(function){
-        case FUNC_CONNECTION:
-            // url_id size (1) + url_id (n bytes) + channel (1) + version(2 bytes)
-            data_size = this->url_size + 4;
+// this function empty the assignment slot on a parameter, in case it has a parameter assigned.
+void Device::parseControlUnassignment(uint8_t* message_in){
+    if(unassign(message_in[UNASSIG_ACT_ID])){
+        sendMessage(FUNC_CONTROL_UNASSIGNMENT);
+    }
+}
 
-        break;
+// the host grants push mode with a period (2 bytes, in ms) and, optionally, the window of each period the device may
+// push in: offset (2 bytes) and length (2 bytes), both in ms. Without them the window is the whole period, which only
+// suits a bus with a single pushing device. A 0 period revokes it. The response holds the period and window the device
+// will use, the periods start when the grant is received.
+void Device::parsePushMode(uint8_t* message_in){
+    uint16_t data_size = message_in[POS_DATA_SIZE1] | (message_in[POS_DATA_SIZE2] << 8);
+    uint8_t* data = &message_in[POS_DATA_SIZE2+1];
+    uint16_t window[3] = {0, 0, 0};
 
-        case FUNC_DEVICE_DESCRIPTOR:
-            // labelsize (1) + label(n) + num_actuators(n) + num_actuators(n) * actuators_description_sizes(n)
-            data_size = 1 + this->label_size + 1;
-            for (i = 0; i < act_counter; ++i){
-                data_size += acts[i]->descriptorSize();
-            }
+    window[0] = (data_size >= 2) ? (data[0] | (data[1] << 8)) : 0;
 
-        break;
+    if(window[0]){
+        if(window[0] < PUSH_MIN_PERIOD){
+            window[0] = PUSH_MIN_PERIOD;
+        }
 
-        case FUNC_DATA_REQUEST:
+        if(data_size >= 6){
+            window[1] = data[2] | (data[3] << 8);
+            window[2] = data[4] | (data[5] << 8);
+        }
+        else{
+            window[2] = window[0];
+        }
 
-            for (i = 0; i < act_counter; ++i){
-                if(acts[i]->checkChange()){
-                    changed_actuators++;
-                }
-            }
+        if(window[1] >= window[0]){
+            window[1] = window[0] - 1;
+        }
+        if(window[2] > window[0] - window[1]){
+            window[2] = window[0] - window[1];
+        }
+        if(!window[2]){
+            window[2] = 1;
+        }
 
-            // (param id (1) + param value (4)) * changed params (n) + params count (1) + addr request count (1) + addr requests(n)
-            data_size = changed_actuators*5 + 2;
+        // the changes pending now go on the first window.
+        this->push_anchor = STimer::static_timer_count;
+        this->push_window = (counter_t) -1;
+    }
 
-                // TODO implementar o pedido de parametro (que ja foi endereçado mas não esta sendo usado) através do ID
+    this->push_enabled = (window[0] != 0);
+    this->push_period = window[0];
+    this->push_offset = window[1];
+    this->push_length = window[2];
 
-        break;
+    sendReply(FUNC_PUSH_MODE, (uint8_t*) window, sizeof(window));
+}
 
-        case FUNC_ERROR:
-            // string (n bytes) + string size (1 byte) + error code (1 byte) + error function (1 byte)
-            for (error_size = 0; error_msg[error_size]; ++error_size);
-            data_size = error_size + 3;
+// the host received the last push.
+void Device::parsePushAck(uint8_t* message_in){
+    (void) message_in;
 
-        break;
+    for (int w = 0; w < DIRTY_WORDS; ++w){
+        pushed[w] = 0;
+    }
+}
 
-        case FUNC_CONTROL_ASSIGNMENT:
-            // response bytes
-            data_size = 2;
-        break;
+// fragment index (1). The whole descriptor is only taken as read after its last fragment.
+void Device::parseDescriptorFragment(uint8_t* message_in){
+    uint8_t index = message_in[POS_DATA_SIZE2+1];
+    uint8_t count = descriptorFragments();
 
-        case FUNC_CONTROL_UNASSIGNMENT:
-            data_size = 0;
-        break;
+    if(index >= count){
+        ERROR("Fragment out of range.");
+        return;
     }
 
-    // MESSAGE HEADER
+    sendMessage(FUNC_DESCRIPTOR_FRAGMENT, index);
 
-    byte_ptr = (uint8_t*) &data_size;
+    if(index + 1 == count && this->state == WAITING_DESCRIPTOR_REQUEST){
+        this->state = WAITING_CONTROL_ASSIGNMENT;
+    }
+}
 
-    this->message_out[msg_idx++] = HOST_ADDRESS;
-    this->message_out[msg_idx++] = this->id;
-    this->message_out[msg_idx++] = function;
-    this->message_out[msg_idx++] = *byte_ptr++;
-    this->message_out[msg_idx++] = *byte_ptr;
+// fragment index (1). A fragment asked again holds the same actuators, with their current values.
+void Device::parseDataFragment(uint8_t* message_in){
+    uint8_t index = message_in[POS_DATA_SIZE2+1];
+
+    if(index >= this->batch_fragments){
+        ERROR("Fragment out of range.");
+        return;
+    }
+
+    sendMessage(FUNC_DATA_FRAGMENT, index);
+}
+
+// encoding (1), the response holds the encoding the device will use, the float one if the asked is unknown.
+void Device::parseValueEncoding(uint8_t* message_in){
+    uint8_t encoding = message_in[POS_DATA_SIZE2+1];
+
+    this->value_encoding = (encoding == VALUE_ENCODING_COMPACT) ? VALUE_ENCODING_COMPACT : VALUE_ENCODING_FLOAT;
+
+    sendReply(FUNC_VALUE_ENCODING, &this->value_encoding, sizeof(this->value_encoding));
+}
+
+// Its responsible for sending all messages, they are written straight on the frame writer, so the data size is
+// computed before the data. The integer returned in this function indicates if the message was sent or not.
+int Device::sendMessage(uint8_t function, int16_t status, const char* error_msg){
+
+    int i;
+    int error_size;
+    int changed_actuators = 0;
+    int first, members = 0;
+    uint16_t data_size, offset;
+    uint8_t fragments;
+    uint32_t bits;
+    uint32_t sent[DIRTY_WORDS] = {0};
+    const uint32_t* set = this->dirty;
+    uint8_t update[1 + sizeof(float)];
+
+    if(!this->writer){
+        return 0;
+    }
 
     switch(function){
         case FUNC_CONNECTION:
+            // url_id size (1) + url_id (n bytes) + channel (1) + version(2 bytes) + generation (2 bytes)
+            this->writer->begin(HOST_ADDRESS, this->id, function, this->url_size + 6);
+            this->writer->put_u8(this->url_size);
+            this->writer->put(this->url_id, this->url_size);
+            this->writer->put_u8(this->channel);
+            this->writer->put_u8(PROTOCOL_VERSION_BYTE1);
+            this->writer->put_u8(PROTOCOL_VERSION_BYTE2);
+            this->writer->put_u8(this->generation & 0xFF);
+            this->writer->put_u8(this->generation >> 8);
+
+        break;
 
-            this->message_out[msg_idx++] = this->url_size;
-            for (i = 0; i < url_size; ++i){
-                this->message_out[msg_idx++] = this->url_id[i];
+        case FUNC_DEVICE_DESCRIPTOR:
+            // the descriptor only changes when actuators or modes are added.
+            if(!this->descriptor_valid || this->descriptor_modes != Mode::modes_occupied){
+                updateDescriptor();
             }
-            this->message_out[msg_idx++] = this->channel;
-            this->message_out[msg_idx++] = PROTOCOL_VERSION_BYTE1;
-            this->message_out[msg_idx++] = PROTOCOL_VERSION_BYTE2;
+
+            this->writer->begin(HOST_ADDRESS, this->id, function, this->descriptor_size);
+            putDescriptor(0, this->descriptor_size);
 
         break;
 
-        case FUNC_DEVICE_DESCRIPTOR:
+        case FUNC_DESCRIPTOR_FRAGMENT:
+            // fragment index (1) + fragments count (1) + fragment (n)
+            fragments = descriptorFragments();
+            offset = status * FRAGMENT_SIZE;
+            data_size = (offset < this->descriptor_size) ? MIN_OF(FRAGMENT_SIZE, this->descriptor_size - offset) : 0;
 
-            this->message_out[msg_idx++] = this->label_size;
+            this->writer->begin(HOST_ADDRESS, this->id, function, 2 + data_size);
+            this->writer->put_u8(status);
+            this->writer->put_u8(fragments);
+            putDescriptor(offset, data_size);
 
-            for (i = 0; i < label_size; ++i){
-                this->message_out[msg_idx++] = this->label[i];
-            }
+        break;
 
-            this->message_out[msg_idx++] = this->act_counter;
+        case FUNC_CONTROL_ASSIGNMENT:
+            // response bytes
+            this->writer->begin(HOST_ADDRESS, this->id, function, sizeof(status));
+            this->writer->put(&status, sizeof(status));
+
+        break;
 
-            for(i = 0; i < act_counter; i++){
-                msg_idx += this->acts[i]->getDescriptor(&this->message_out[msg_idx]);
+        case FUNC_DATA_FRAGMENT:
+        case FUNC_DATA_REQUEST:
+        case FUNC_DATA_PUSH:
+            // [fragment index (1) + fragments count (1)] + params count (1) + (param id (1) + param value (4, 1 or 2
+            // if compact)) * changed params (n) + addr request count (1) + addr requests(n)
+            // the actuators sent are chosen before the header, the ones unassigned meanwhile are dropped. At most
+            // UPDATES_PER_FRAME are sent, the others stay dirty. A data fragment holds the batch actuators in it.
+            if(function == FUNC_DATA_FRAGMENT){
+                set = this->batch;
             }
+            first = (function == FUNC_DATA_FRAGMENT) ? status * UPDATES_PER_FRAME : 0;
+            data_size = 2 + assig_requests_count + ((function == FUNC_DATA_FRAGMENT) ? 2 : 0);
 
-        break;
+            for (int w = 0; w < DIRTY_WORDS && members < first + UPDATES_PER_FRAME; ++w){
+                bits = set[w];
+                while(bits && members < first + UPDATES_PER_FRAME){
+                    i = w*32 + __builtin_ctzl(bits);
+                    bits &= bits - 1;
 
-        case FUNC_CONTROL_ASSIGNMENT: //control assignment and unassignment
+                    if(members++ < first){
+                        continue;
+                    }
 
-            byte_ptr = (uint8_t*) &status;
+                    if(!acts[i]->assignments_occupied){
+                        dirty[w] &= ~((uint32_t) 1 << (i % 32));
+                        continue;
+                    }
 
-            this->message_out[msg_idx++] = *byte_ptr++;
-            this->message_out[msg_idx++] = *byte_ptr;
+                    data_size += this->acts[i]->updateSize(this->value_encoding);
+                    changed_actuators++;
+                    sent[w] |= (uint32_t) 1 << (i % 32);
+                }
+            }
 
-        break;
+            this->writer->begin(HOST_ADDRESS, this->id, function, data_size);
+            if(function == FUNC_DATA_FRAGMENT){
+                this->writer->put_u8(status);
+                this->writer->put_u8(this->batch_fragments);
+            }
+            this->writer->put_u8(changed_actuators);
 
-        case FUNC_DATA_REQUEST:
+            for (int w = 0; w < DIRTY_WORDS; ++w){
+                bits = sent[w];
+                while(bits){
+                    i = w*32 + __builtin_ctzl(bits);
+                    bits &= bits - 1;
 
-            this->message_out[msg_idx++] = changed_actuators;
+                    this->writer->put(update, this->acts[i]->getUpdate(update, this->value_encoding));
 
-            for (i = 0; i < act_counter; ++i){
-                if(acts[i]->changed){
-                    msg_idx += this->acts[i]->getUpdate(&this->message_out[msg_idx]);
+                    // changes are measured from the last value sent.
+                    this->acts[i]->old_value = this->acts[i]->value;
                 }
             }
 
-            this->message_out[msg_idx++] = 0; // assignment request ( endereçamentos reservados na memória da pedaleira em vez do device)
+            // assignments asked by the device, the host answers them with control assignments.
+            this->writer->put_u8(assig_requests_count);
+            this->writer->put(assig_requests, assig_requests_count);
+            assig_requests_count = 0;
 
         break;
 
-        case FUNC_CONTROL_UNASSIGNMENT: //control assignment and unassignment
-
+        case FUNC_CONTROL_UNASSIGNMENT:
+            this->writer->begin(HOST_ADDRESS, this->id, function, 0);
         break;
 
-        case FUNC_ERROR: //TODO
-            this->message_out[msg_idx++] = 1; // error within function
+        case FUNC_ERROR:
+            // error function (1 byte) + error code (1 byte) + string size (1 byte) + string (n bytes)
+            for (error_size = 0; error_msg[error_size] && error_size < MAX_ERROR_SIZE; ++error_size);
 
-            this->message_out[msg_idx++] = 1; // error code
+            this->writer->begin(HOST_ADDRESS, this->id, function, 3 + error_size);
 
-            this->message_out[msg_idx++] = error_size;
+            this->writer->put_u8(1); // error within function
 
-            for(i = 0; i < error_size; i++){
-                this->message_out[msg_idx++] = error_msg[i];
-            }
+            this->writer->put_u8(1); // error code
+
+            this->writer->put_u8(error_size);
+
+            this->writer->put(error_msg, error_size);
 
         break;
 
+        default:
+            return 0;
     }
 
-    msg_ready_cb(this->message_out);
+    this->writer->end();
 
     // this loop runs an a post message rotine. The main purpose of this routine is to clean the 'changed' flag on actuators, specially
     // those with a trigger assigned.
-    for (int i = 0; i < act_counter; ++i){
-        if(acts[i]->changed)
-            acts[i]->postMessageRotine();
+    if(function == FUNC_DATA_REQUEST || function == FUNC_DATA_PUSH || function == FUNC_DATA_FRAGMENT){
+        for (int w = 0; w < DIRTY_WORDS; ++w){
+            bits = sent[w];
+            dirty[w] &= ~bits;
+            if(function == FUNC_DATA_PUSH){
+                pushed[w] |= bits;
+            }
+            while(bits){
+                i = w*32 + __builtin_ctzl(bits);
+                bits &= bits - 1;
+
+                acts[i]->postMessageRotine();
+            }
+        }
+    }
+
+    return 1;
+}
+
+// sends a message with a function registered by the sketch, data is written as the message data field.
+int Device::sendReply(uint8_t function, const uint8_t* data, uint16_t data_size){
+    if(!this->writer || data_size > MAX_REPLY_SIZE){
+        return 0;
     }
 
+    this->writer->begin(HOST_ADDRESS, this->id, function, data_size);
+    this->writer->put(data, data_size);
+    this->writer->end();
+
     return 1;
 }
 
 // initialize conversation between device and host
 void Device::connectDevice(){
-    static bool timer_flag = true;
 
     // checks if device is trying to connect yet.
     if(this->state == CONNECTING){
@@ -399,16 +969,30 @@ void Device::connectDevice(){
         checkConnectLED();
 
         // This timer sets a random period to send a connecting (or handshaking) message.
-        if(timer_flag){
-            timer_flag = false;
-            timer_connecting.setPeriod(RANDOM_FUNCTION(RANDOM_CONNECT_RANGE_BOTTOM, RANDOM_CONNECT_RANGE_TOP));
+        if(!connecting_timer_set){
+            connecting_timer_set = true;
+
+            // garbled frames mean other devices are connecting at the same time, the window grows as if the message
+            // was lost.
+            if(bus_errors_cb){
+                uint16_t errors = bus_errors_cb();
+                if(errors != this->bus_errors && this->connect_attempts < 255){
+                    this->connect_attempts++;
+                }
+                this->bus_errors = errors;
+            }
+
+            timer_connecting.setPeriod(connectDelay());
             timer_connecting.start();
         }
 
-        // if the alarm is triggered.
-        if(timer_connecting.check()){
-            // timer flag indicates
-            timer_flag = true;
+        // if the alarm is triggered, the message waits the end of any frame being received.
+        if((!bus_busy_cb || !bus_busy_cb()) && timer_connecting.check()){
+            // a new interval is chosen for the next message.
+            connecting_timer_set = false;
+            if(this->connect_attempts < 255){
+                this->connect_attempts++;
+            }
             sendMessage(FUNC_CONNECTION);
         }
     }
@@ -418,17 +1002,70 @@ void Device::connectDevice(){
     }
 }
 
+// returns the interval until the next connecting message, drawn from a window that doubles on each attempt.
+counter_t Device::connectDelay(){
+    uint8_t steps = connect_attempts < CONNECT_BACKOFF_STEPS ? connect_attempts : CONNECT_BACKOFF_STEPS;
+    uint32_t window = (uint32_t) (RANDOM_CONNECT_RANGE_TOP - RANDOM_CONNECT_RANGE_BOTTOM) << steps;
+
+    return RANDOM_CONNECT_RANGE_BOTTOM + nextRandom() % window;
+}
+
+// xorshift generator, different devices (URL and channel) give different sequences.
+uint32_t Device::nextRandom(){
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+
+    return random_state;
+}
+
 // If timer_led is triggered, the led light is changed to HIGH or LOW, depending on its previous state.
 void Device::checkConnectLED(){
-    static bool ledpos = 0;
     if(timer_led.check()){
-        DIGITAL_WRITE(USER_LED,ledpos); //ard
-        ledpos^= 1;
+        DIGITAL_WRITE(USER_LED,led_state); //ard
+        led_state ^= 1;
         timer_led.start();
     }
 }
 
+// in push mode, sends the changed actuators values on the next window granted by the host with the bus idle. The
+// actuators of a push not acknowledged until the next window are sent again.
+void Device::pushValues(){
+    counter_t elapsed, window;
+    bool pending = false;
+
+    if(!this->push_enabled || this->state != WAITING_DATA_REQUEST){
+        return;
+    }
+
+    elapsed = STimer::static_timer_count - this->push_anchor;
+    window = elapsed / this->push_period;
+    elapsed %= this->push_period;
+
+    if(window == this->push_window || elapsed < this->push_offset || elapsed >= this->push_offset + this->push_length){
+        return;
+    }
+
+    for (int w = 0; w < DIRTY_WORDS; ++w){
+        dirty[w] |= pushed[w];
+        pushed[w] = 0;
+        if(dirty[w])
+            pending = true;
+    }
+
+    if(pending && (!bus_busy_cb || !bus_busy_cb())){
+        this->push_window = window;
+        sendMessage(FUNC_DATA_PUSH);
+    }
+}
+
 void Device::run(){
+    // messages received by the uart interrupt are parsed here, out of the interrupt context.
+    if(msg_poll_cb)
+        msg_poll_cb();
+
+    checkTimeout();
     connectDevice();
     refreshValues();
+    pushValues();
 }
\ No newline at end of file
@@ -14,13 +14,92 @@ enum{CTRLADDR_ACT_ID=6, CTRLADDR_CHOSEN_MASK1, CTRLADDR_CHOSEN_MASK2, CTRLADDR_A
 // Device state machine, it gives a hint about which message the device can receive or should send.
 enum{CONNECTING = 1, WAITING_DESCRIPTOR_REQUEST, WAITING_CONTROL_ASSIGNMENT, WAITING_DATA_REQUEST}; //device state
 
+// used to build the mask of states in which a function is accepted.
+#define STATE_BIT(state)    (1 << (state))
+
 // device addressing
 enum{DESTINATION = 1, ORIGIN};
 
+// control assignment status, sent on the bulk assignment response (the single one only tells 0 or -1)
+enum{ASSIGN_OK = 0, ASSIGN_FAILED = -1, ASSIGN_NO_ACTUATOR = -2, ASSIGN_MODE_NOT_SUPPORTED = -3, ASSIGN_SLOTS_FULL = -4,
+    ASSIGN_MALFORMED = -5};
+
 #ifndef MAX_ACTUATORS
 #define MAX_ACTUATORS   1 // max number of actuators
 #endif
 
+#define DIRTY_WORDS     ((MAX_ACTUATORS + 31) / 32) // words on the changed actuators bitmap
+
+#ifndef SAMPLE_BUDGET
+#define SAMPLE_BUDGET   MAX_ACTUATORS // max number of actuators sampled on each run, the others wait the next one
+#endif
+
+#ifndef MAX_USER_FUNCTIONS
+#define MAX_USER_FUNCTIONS  4 // function codes that can be registered from the sketch
+#endif
+
+#ifndef ID_TABLE_SIZE
+#define ID_TABLE_SIZE   32 // actuator and assignment ids below this are found by indexing, the others by searching
+#endif
+
+#ifndef MAX_URL_SIZE
+#define MAX_URL_SIZE    64 // longer URLs are cut
+#endif
+
+#ifndef MAX_ERROR_SIZE
+#define MAX_ERROR_SIZE  40 // longer error messages are cut
+#endif
+
+#ifndef MAX_REPLY_SIZE
+#define MAX_REPLY_SIZE  32 // data size limit of the messages sent by sendReply()
+#endif
+
+#ifndef MAX_BULK_ASSIGNMENTS
+#define MAX_BULK_ASSIGNMENTS    16 // assignments on a bulk assignment message, its response must fit MAX_REPLY_SIZE
+#endif
+
+#ifndef MAX_ASSIGNMENT_REQUESTS
+#define MAX_ASSIGNMENT_REQUESTS 4 // assignments the device can ask the host on a data request response
+#endif
+
+#ifndef FRAGMENT_SIZE
+#define FRAGMENT_SIZE   128 // bigger descriptors are sent in fragments of this size
+#endif
+
+// updates on a data request response, the actuators changed beyond it are sent in fragments (or on the next push)
+#define UPDATES_PER_FRAME           ((FRAGMENT_SIZE - 2 - MAX_ASSIGNMENT_REQUESTS) / 5)
+
+// Worst case data size of each message, they only depend on the limits above and the ones on config.h.
+// url size (1) + url (n) + channel (1) + version (2) + generation (2)
+#define CONNECTION_MAX_SIZE         (6 + MAX_URL_SIZE)
+// label size (1) + label (n) + actuators count (1) + actuators (n)
+#define DESCRIPTOR_MAX_SIZE         (2 + MAX_NAME_SIZE + MAX_ACTUATORS*ACTUATOR_DESCRIPTOR_MAX_SIZE)
+// updates count (1) + (assignment id (1) + value (4)) * actuators (n) + assignment requests count (1) +
+// assignment requests (1 each)
+#define DATA_REQUEST_MAX_SIZE       (2 + 5*MIN_OF(MAX_ACTUATORS, UPDATES_PER_FRAME) + MAX_ASSIGNMENT_REQUESTS)
+// fragment index (1) + fragments count (1) + fragment (n)
+#define FRAGMENT_MAX_SIZE           (2 + FRAGMENT_SIZE)
+// error function (1) + error code (1) + message size (1) + message (n)
+#define ERROR_MAX_SIZE              (3 + MAX_ERROR_SIZE)
+// actuator id (1) + masks (2) + assignment id (1) + port mask (1) + label size (1) + label (n) + value, minimum,
+// maximum and default (16) + steps (2) + unit size (1) + unit (n) + scale points count (1) + scale points (n)
+#define CONTROL_ASSIGNMENT_MAX_SIZE (26 + 2*MAX_STRING_SIZE + MAX_SCALE_POINTS*(5 + MAX_STRING_SIZE))
+
+#define MAX_OF(a, b)                ((a) > (b) ? (a) : (b))
+#define MIN_OF(a, b)                ((a) < (b) ? (a) : (b))
+
+// descriptors and data request responses bigger than a frame are sent in fragments, which are never bigger than this
+#define DESCRIPTOR_FRAME_MAX_SIZE   (DESCRIPTOR_MAX_SIZE > FRAGMENT_SIZE ? FRAGMENT_MAX_SIZE : DESCRIPTOR_MAX_SIZE)
+#define DATA_FRAME_MAX_SIZE         (MAX_ACTUATORS > UPDATES_PER_FRAME ? 2 + DATA_REQUEST_MAX_SIZE : DATA_REQUEST_MAX_SIZE)
+
+// the biggest message the device sends, the assignment and push mode responses (2 bytes) are smaller than any of these
+#define MESSAGE_MAX_SIZE            MAX_OF(MAX_OF(CONNECTION_MAX_SIZE, DESCRIPTOR_FRAME_MAX_SIZE), \
+                                        MAX_OF(MAX_OF(DATA_FRAME_MAX_SIZE, ERROR_MAX_SIZE), MAX_REPLY_SIZE))
+
+#ifndef DESCRIPTOR_CACHE_SIZE
+#define DESCRIPTOR_CACHE_SIZE   DESCRIPTOR_MAX_SIZE // bigger descriptors are serialized on every request
+#endif
+
 #ifndef SET_PIN_MODE
 #define SET_PIN_MODE(pin, mode) ;
 #endif
@@ -29,10 +108,6 @@ enum{DESTINATION = 1, ORIGIN};
 #define DIGITAL_WRITE(pin, value) ;
 #endif
 
-#ifndef RANDOM_FUNCTION
-#define RANDOM_FUNCTION(bottom, top) 10
-#endif
-
 #ifndef ERROR
 #define ERROR(str) sendMessage(FUNC_ERROR, 0, str);
 #endif
@@ -71,14 +146,56 @@ enum{DESTINATION = 1, ORIGIN};
 #define FUNC_CONTROL_ASSIGNMENT     0x03
 #define FUNC_DATA_REQUEST           0x04
 #define FUNC_CONTROL_UNASSIGNMENT   0x05
+#define FUNC_PUSH_MODE              0x06 // host grants (or revokes) the device the right to send changes on its own
+#define FUNC_DATA_PUSH              0x07 // changes sent by the device, same data as a data request response. The host
+                                         // acknowledges them with an empty FUNC_DATA_PUSH
+#define FUNC_DESCRIPTOR_FRAGMENT    0x08 // host asks a descriptor fragment, the answer holds it with its index and count
+#define FUNC_DATA_FRAGMENT          0x09 // same for the data request responses with more than UPDATES_PER_FRAME updates
+#define FUNC_VALUE_ENCODING         0x0A // host chooses how the updates values are sent, see Assignment::compactSize()
+#define FUNC_BULK_ASSIGNMENT        0x0B // several control assignments, answered with the status of each one
 #define FUNC_ERROR                  0xFF
 
+#define BUILTIN_FUNCTIONS_COUNT     (FUNC_BULK_ASSIGNMENT + 1) // builtin function codes go from 1 to this - 1
+
 #define UNASSIG_ACT_ID              POS_DATA_SIZE2+1
 #define POLLING_PERIOD              2
-#define DEVICE_TIMEOUT_PERIOD       32*POLLING_PERIOD
+#ifndef DEVICE_TIMEOUT_PERIOD
+#define DEVICE_TIMEOUT_PERIOD       32*POLLING_PERIOD // without frames from the host for this long the device reconnects, 0 disables it
+#endif
 #define RANDOM_CONNECT_RANGE_BOTTOM 32
 #define RANDOM_CONNECT_RANGE_TOP    320
 
+#ifndef CONNECT_BACKOFF_STEPS
+#define CONNECT_BACKOFF_STEPS       4 // the connecting messages window doubles this many times at most
+#endif
+
+#ifndef PUSH_MIN_PERIOD
+#define PUSH_MIN_PERIOD             1 // in ms, shortest interval between two pushes the device accepts
+#endif
+
+class Device;
+
+// handler of a function registered from the sketch, it receives the device and the whole received message.
+typedef void (*function_handler_t)(Device* dev, uint8_t* message_in);
+
+// protocol function table entry.
+typedef struct FUNCTION_T {
+    uint8_t             function;                       // function code
+    uint8_t             states;                         // STATE_BIT of the states in which the function is accepted
+    const char*         state_error;                    // error sent when the function arrives in any other state
+    void (Device::*handler)(uint8_t* message_in);       // builtin handler
+    function_handler_t  user_handler;                   // handler registered from the sketch
+} function_t;
+
+// where the messages are streamed to, the comm_frame_* functions on the ControlChain. begin takes the data size, which
+// the device computes before writing, the data goes through put_u8 and put and end closes the frame.
+typedef struct FRAME_WRITER_T {
+    void (*begin)(uint8_t destination, uint8_t origin, uint8_t function, uint16_t data_size);
+    void (*put_u8)(uint8_t value);
+    void (*put)(const void* data, uint16_t size);
+    bool (*end)(void);
+} frame_writer_t;
+
 /*
 ************************************************************************************************************************
 This class represents the model of a physic device, so it holds a list
@@ -98,27 +215,71 @@ public:
     uint8_t     num_actuators;          // adding actuator capacity
     uint8_t     act_counter;        // quantity of actuators added to the device
     uint8_t     state;                  // state in which the device is, protocol-wise
+    uint8_t     resume_state;           // state left when the link timed out, resumed if the host keeps the generation
+    uint16_t    generation;             // token given by the host on connection, 0 if there is no state to resume
 
     Actuator*   acts[MAX_ACTUATORS];    // vector which holds all actuators pointers
+    uint32_t    dirty[DIRTY_WORDS];     // bit i is set when acts[i] value changed since the last data request
+    uint32_t    batch[DIRTY_WORDS];     // actuators of the data request response being sent in fragments
+    uint8_t     batch_fragments;        // fragments of that response, 0 if there is none
 
-    STimer      timer_connecting;       // take care of holding a random intervals to send connecting message.
-    STimer      timer_led;              // holds led's blinking period.
-
-    uint8_t*    message_out;            // state in which the device is, protocol-wise
+    uint8_t     act_index[ID_TABLE_SIZE];       // actuator id -> acts[] index + 1, 0 if there is no such actuator
+    Actuator*   assig_act[ID_TABLE_SIZE];       // assignment id -> actuator holding it
+    Assignment* assig_slot[ID_TABLE_SIZE];      // assignment id -> slot holding it
 
-    void (*msg_ready_cb)(uint8_t* in_buff);
+    uint8_t     assig_requests[MAX_ASSIGNMENT_REQUESTS];    // assignment ids asked to the host on the next data request
+    uint8_t     assig_requests_count;
 
+    STimer      timer_connecting;       // take care of holding a random intervals to send connecting message.
+    STimer      timer_led;              // holds led's blinking period.
+    bool        connecting_timer_set;   // the random interval to send the next connecting message was chosen.
+    uint8_t     connect_attempts;       // unanswered connecting messages (and collisions seen) since the last connection
+    uint16_t    bus_errors;             // garbled frames count when the last connecting interval was chosen
+    uint32_t    random_state;           // random generator of the connecting intervals, seeded from URL and channel
+    bool        led_state;
+    counter_t   push_anchor;            // time push mode was granted, the push windows are counted from it
+    uint16_t    push_period;            // in ms, a push window opens once per period
+    uint16_t    push_offset;            // in ms, window start from the period start
+    uint16_t    push_length;            // in ms, window length
+    counter_t   push_window;            // index of the window of the last push, a single push goes per window
+    uint32_t    pushed[DIRTY_WORDS];    // actuators pushed and not acknowledged, dirty again if the ack misses
+    STimer      timer_timeout;          // time since the last frame received from the host.
+    STimer      timer_sample[MAX_ACTUATORS];    // sample period of each actuator, acts[i] is sampled when it expires.
+    uint8_t     sample_next;            // actuator where the next sampling round starts.
+    bool        push_enabled;           // host granted push mode, changes are sent without waiting a data request
+    uint8_t     value_encoding;         // encoding of the updates values, VALUE_ENCODING_FLOAT until the host asks other
+
+    uint8_t     descriptor[DESCRIPTOR_CACHE_SIZE];  // serialized device descriptor
+    uint16_t    descriptor_size;        // descriptor size, valid while descriptor_valid is true
+    bool        descriptor_valid;       // false after anything that changes the descriptor
+    bool        descriptor_cached;      // descriptor fits and is serialized on the descriptor array
+    int         descriptor_modes;       // registered modes count when the descriptor was serialized
+
+    const frame_writer_t* writer;       // the messages are written straight on it, no frame is built on the device
+
+    void (*msg_poll_cb)(void);
+    bool (*bus_busy_cb)(void);
+    uint16_t (*bus_errors_cb)(void);
+
+    function_t  user_functions[MAX_USER_FUNCTIONS];     // functions registered from the sketch
+    uint8_t     user_functions_count;
+
+    // the URL is cut to MAX_URL_SIZE and the label to MAX_NAME_SIZE.
     Device(const char* url_id, const char* label, uint8_t channel);
 
     ~Device();
 
     void init();
 
-    // callback for input message reading.
-    void setCallback(void (*msg_ready_cb)(uint8_t* in_buff));
+    // frame writer the output messages are streamed to.
+    void setWriter(const frame_writer_t* writer);
+
+    // callback that delivers the received messages to parse(), it's called on every run().
+    void setPollCallback(void (*msg_poll_cb)(void));
 
-    // where device will write its output message.
-    void setOutBuffer(uint8_t* message_out);
+    // callbacks telling if a frame is being received and how many garbled frames were received, they make the
+    // connecting messages wait a free bus and back off when other devices are connecting too.
+    void setBusCallbacks(bool (*bus_busy_cb)(void), uint16_t (*bus_errors_cb)(void));
 
     // Put device to work.
     void run();
@@ -135,26 +296,92 @@ public:
     // receives actuator id (not necessarily equal to actuator's index on acts[]) and returns a pointer to that actuator
     Actuator* searchActuator(int id);
 
-    // runs value calculation function on actuator class (or sub class)
+    // frees the assignment with the given id, whichever actuator holds it.
+    bool unassign(uint8_t assignment_id);
+
+    // frees all assignments of all actuators.
+    void unassignAll();
+
+    // changes the assignment slots of an actuator at runtime, the host reads them on the next descriptor.
+    bool setAssignmentSlots(Actuator* act, uint8_t count);
+
+    // asks the host to send the assignment with the given id, e.g. after it was lost on a reboot. The ids go on the next
+    // data request response (or push) only once, returns false if there is no room left.
+    bool requestAssignment(uint8_t assignment_id);
+
+    // runs value calculation function on the actuators whose sample period expired, at most SAMPLE_BUDGET of them,
+    // and marks the ones that changed as dirty
     void refreshValues();
 
+    // serializes the device descriptor on the cache and updates its size.
+    void updateDescriptor();
+
+    // writes the device descriptor on buffer, returns the number of written bytes.
+    int writeDescriptor(uint8_t* buffer);
+
+    // puts size bytes of the device descriptor from offset on the frame writer. When the descriptor isn't cached only
+    // the actuators overlapping the range are serialized, one at a time.
+    void putDescriptor(uint16_t offset, uint16_t size);
+
+    // number of fragments the descriptor is sent in, 1 if it fits FRAGMENT_SIZE.
+    uint8_t descriptorFragments();
+
 /*
 ************************************************************************************************************************
 *           Communication Related
 ************************************************************************************************************************
 */
+    // takes the device back to connecting, keeping the actuators assignments to be resumed.
     void timeoutReset();
 
+    // calls timeoutReset() if no frame was received from the host for DEVICE_TIMEOUT_PERIOD.
+    void checkTimeout();
+
     // This function parses the data field (mainly) on a received message, it takes care of all the functions from protocol
     void parse(uint8_t* message_in);
 
-    // Its responsible for sending all messages, but don´t send them, it calls another function (send) which will handle that.
+    // checks if a connection response has this device URL and channel.
+    bool matchConnection(uint8_t* message_in);
+
+    // handlers of the protocol functions, called by parse() when the function is accepted in the current state.
+    void parseConnection(uint8_t* message_in);
+    void parseDescriptorRequest(uint8_t* message_in);
+    void parseControlAssignment(uint8_t* message_in);
+    void parseDataRequest(uint8_t* message_in);
+    void parseControlUnassignment(uint8_t* message_in);
+    void parsePushMode(uint8_t* message_in);
+    void parsePushAck(uint8_t* message_in);
+    void parseDescriptorFragment(uint8_t* message_in);
+    void parseDataFragment(uint8_t* message_in);
+    void parseValueEncoding(uint8_t* message_in);
+    void parseBulkAssignment(uint8_t* message_in);
+
+    // assigns a control from record, laid out as a control assignment message data. Returns an ASSIGN_ status.
+    int8_t assignControl(const uint8_t* record);
+
+    // registers a handler to a function code not used by the protocol, states is a mask made with STATE_BIT.
+    // returns false if the code is reserved or there is no room for it.
+    bool registerFunction(uint8_t function, uint8_t states, function_handler_t handler);
+
+    // Its responsible for sending all messages, they are written straight on the frame writer.
     // The integer returned in this function indicates if the message was sent or not.
-    int sendMessage(uint8_t function, int16_t status = 0 /*control addressing status*/, const char* error_msg = "");
+    int sendMessage(uint8_t function, int16_t status = 0 /*control addressing status or fragment index*/, const char* error_msg = "");
+
+    // sends a message with a function registered by the sketch, data is copied as the message data field.
+    int sendReply(uint8_t function, const uint8_t* data, uint16_t data_size);
 
     // initialize conversation between device and host
     void connectDevice();
 
+    // returns the interval until the next connecting message, drawn from a window that doubles on each attempt.
+    counter_t connectDelay();
+
+    // xorshift generator, different devices (URL and channel) give different sequences.
+    uint32_t nextRandom();
+
+    // in push mode, sends the changed actuators values on the next window granted by the host with the bus idle.
+    void pushValues();
+
     // If timerLED is triggered, the led light is changed to HIGH or LOW, depending on the previous status.
     void checkConnectLED();
 
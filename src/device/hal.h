@@ -0,0 +1 @@
+../hal/hal.h
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "config.h"
 #include "device.h"
 #include "button.h"
@@ -22,7 +23,7 @@ public:
 		// min = 0;
 	}
 
-	float getValue( ){
+	reading_t getValue( ){
 		return get_value;
 	}
 
@@ -36,7 +37,7 @@ public:
 		// min = 0;
 	}
 
-	float getValue( ){
+	reading_t getValue( ){
 		return get_value;
 	}
 
@@ -60,6 +61,36 @@ void messagePrint(uint8_t* buff){
 	}
 }
 
+// the messages are assembled on message_out and printed when they end
+uint8_t message_out[2560];
+uint16_t message_idx;
+
+void messageBegin(uint8_t destination, uint8_t origin, uint8_t function, uint16_t data_size){
+	message_out[POS_SYNC] = BYTE_SYNC;
+	message_out[POS_DEST] = destination;
+	message_out[POS_ORIG] = origin;
+	message_out[POS_FUNC] = function;
+	message_out[POS_DATA_SIZE1] = data_size & 0xFF;
+	message_out[POS_DATA_SIZE2] = data_size >> 8;
+	message_idx = POS_DATA_SIZE2 + 1;
+}
+
+void messagePutU8(uint8_t value){
+	message_out[message_idx++] = value;
+}
+
+void messagePut(const void* data, uint16_t size){
+	memcpy(&message_out[message_idx], data, size);
+	message_idx += size;
+}
+
+bool messageEnd(){
+	messagePrint(message_out);
+	return true;
+}
+
+const frame_writer_t message_writer = {messageBegin, messagePutU8, messagePut, messageEnd};
+
 int main(){
 
 	uint8_t _connect[] =			{'\xAA','\x80','\x00','\x01','\x23','\x00','\x1F','h','t','t','p',':','/','/','p','o','r','t','a','l','m','o','d','.','c','o','m','/','d','e','v','i','c','e','s','/','X','P','\x01','\x01','\x00','\xEF'};
@@ -75,12 +106,9 @@ int main(){
 	uint8_t _control_unassig1[] = 	{'\xAA','\x80','\x00','\x05','\x01','\x00','\x01','\x31'};
 	uint8_t _control_unassig1_5[] =	{'\xAA','\x80','\x00','\x05','\x01','\x00','\x0f','\x3f'};
 
-	uint8_t _message_out[2560];
-
 	Device dev("http://portalmod.com/devices/XP", "Testing Device", 1);
 
-	dev.setOutBuffer(_message_out);
-	dev.setCallback(messagePrint);
+	dev.setWriter(&message_writer);
 
 	Actuator* search;
 
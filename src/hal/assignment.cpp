@@ -0,0 +1 @@
+../assignment/assignment.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../assignment/assignment.h
\ No newline at end of file
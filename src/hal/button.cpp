@@ -0,0 +1 @@
+../impl_actuator/button.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../impl_actuator/button.h
\ No newline at end of file
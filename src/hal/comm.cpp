@@ -0,0 +1 @@
+../comm/comm.cpp
\ No newline at end of file
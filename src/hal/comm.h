@@ -0,0 +1 @@
+../comm/comm.h
\ No newline at end of file
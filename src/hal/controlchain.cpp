@@ -0,0 +1 @@
+../controlchain/controlchain.cpp
\ No newline at end of file
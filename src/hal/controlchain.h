@@ -0,0 +1 @@
+../controlchain/controlchain.h
\ No newline at end of file
@@ -0,0 +1 @@
+../device/device.h
\ No newline at end of file
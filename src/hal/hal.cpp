@@ -0,0 +1,243 @@
+
+// includes
+#include "hal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// local variables
+
+static hal_transport_t *g_transport = NULL;
+static void (*g_tick_cb)(void) = NULL;
+static uint64_t g_last_ms;
+
+////////////////////////////////////////////////////////////////////////////////
+// local functions definitions
+
+static int fifo_write(hal_fifo_t *fifo, const uint8_t *buffer, uint16_t size)
+{
+    int written = 0;
+
+    while (size--)
+    {
+        uint16_t next = (fifo->head + 1) % HAL_FIFO_SIZE;
+        if (next == fifo->tail) break;
+
+        fifo->data[fifo->head] = *buffer++;
+        fifo->head = next;
+        written++;
+    }
+
+    return written;
+}
+
+static int fifo_read(hal_fifo_t *fifo, uint8_t *buffer, uint16_t size)
+{
+    int read = 0;
+
+    while (size-- && fifo->tail != fifo->head)
+    {
+        *buffer++ = fifo->data[fifo->tail];
+        fifo->tail = (fifo->tail + 1) % HAL_FIFO_SIZE;
+        read++;
+    }
+
+    return read;
+}
+
+static bool loopback_open(void *ctx, uint32_t baud_rate)
+{
+    hal_loopback_t *loopback = (hal_loopback_t *) ctx;
+    (void) baud_rate;
+
+    loopback->to_device.head = loopback->to_device.tail = 0;
+    loopback->from_device.head = loopback->from_device.tail = 0;
+
+    return true;
+}
+
+static int loopback_read(void *ctx, uint8_t *buffer, uint16_t size)
+{
+    return fifo_read(&((hal_loopback_t *) ctx)->to_device, buffer, size);
+}
+
+static int loopback_write(void *ctx, const uint8_t *buffer, uint16_t size)
+{
+    return fifo_write(&((hal_loopback_t *) ctx)->from_device, buffer, size);
+}
+
+static speed_t serial_speed(uint32_t baud_rate)
+{
+    switch (baud_rate)
+    {
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 500000:    return B500000;
+        case 1000000:   return B1000000;
+    }
+
+    return B0;
+}
+
+static bool serial_open(void *ctx, uint32_t baud_rate)
+{
+    hal_serial_t *serial = (hal_serial_t *) ctx;
+    struct termios tty;
+    int fd;
+
+    if (serial->path)
+    {
+        serial->fd = open(serial->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        fd = serial->fd;
+    }
+    else
+    {
+        serial->fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (serial->fd < 0 || grantpt(serial->fd) || unlockpt(serial->fd)) return false;
+
+        snprintf(serial->pty_name, sizeof(serial->pty_name), "%s", ptsname(serial->fd));
+        fcntl(serial->fd, F_SETFL, O_NONBLOCK);
+
+        // keeps the slave side opened, otherwise the master reads fail until the host connects
+        serial->slave_fd = open(serial->pty_name, O_RDWR | O_NOCTTY);
+        fd = serial->slave_fd;
+    }
+
+    if (fd < 0 || tcgetattr(fd, &tty)) return false;
+
+    cfmakeraw(&tty);
+    if (serial_speed(baud_rate) != B0)
+    {
+        cfsetispeed(&tty, serial_speed(baud_rate));
+        cfsetospeed(&tty, serial_speed(baud_rate));
+    }
+
+    return tcsetattr(fd, TCSANOW, &tty) == 0;
+}
+
+static int serial_read(void *ctx, uint8_t *buffer, uint16_t size)
+{
+    int ret = read(((hal_serial_t *) ctx)->fd, buffer, size);
+    return ret > 0 ? ret : 0;
+}
+
+// the fd is non blocking, so a full output queue is waited for instead of dropping the remaining bytes
+static int serial_write(void *ctx, const uint8_t *buffer, uint16_t size)
+{
+    int fd = ((hal_serial_t *) ctx)->fd;
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    uint16_t written = 0;
+
+    while (written < size)
+    {
+        int ret = write(fd, buffer + written, size - written);
+
+        if (ret > 0)
+        {
+            written += ret;
+        }
+        else if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // gives up if the other side doesn't read for HAL_SERIAL_WRITE_TIMEOUT
+            if (poll(&pfd, 1, HAL_SERIAL_WRITE_TIMEOUT) <= 0) break;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return written;
+}
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// global functions definitions
+
+void hal_set_transport(hal_transport_t *transport)
+{
+    g_transport = transport;
+}
+
+hal_transport_t* hal_get_transport(void)
+{
+    return g_transport;
+}
+
+void hal_loopback_init(hal_loopback_t *loopback, hal_transport_t *transport)
+{
+    loopback_open(loopback, 0);
+
+    transport->ctx = loopback;
+    transport->open = loopback_open;
+    transport->read = loopback_read;
+    transport->write = loopback_write;
+}
+
+int hal_loopback_host_write(hal_loopback_t *loopback, const uint8_t *buffer, uint16_t size)
+{
+    return fifo_write(&loopback->to_device, buffer, size);
+}
+
+int hal_loopback_host_read(hal_loopback_t *loopback, uint8_t *buffer, uint16_t size)
+{
+    return fifo_read(&loopback->from_device, buffer, size);
+}
+
+void hal_serial_init(hal_serial_t *serial, const char *path, hal_transport_t *transport)
+{
+    serial->path = path;
+    serial->fd = -1;
+    serial->slave_fd = -1;
+    serial->pty_name[0] = 0;
+
+    transport->ctx = serial;
+    transport->open = serial_open;
+    transport->read = serial_read;
+    transport->write = serial_write;
+}
+
+void hal_timer_attach(void (*tick_cb)(void))
+{
+    g_tick_cb = tick_cb;
+    g_last_ms = monotonic_ms();
+}
+
+void hal_timer_tick(uint32_t ms)
+{
+    if (!g_tick_cb) return;
+
+    while (ms--) g_tick_cb();
+}
+
+void hal_timer_poll(void)
+{
+    uint64_t now = monotonic_ms();
+
+    hal_timer_tick(now - g_last_ms);
+    g_last_ms = now;
+}
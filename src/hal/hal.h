@@ -0,0 +1,96 @@
+#ifndef HAL_H
+#define HAL_H
+
+// This file replaces <Arduino.h> when the library is built as a regular Linux process. It provides the few Arduino
+// calls used by the library, a pluggable transport which plays the uart role and a polled timer which plays the
+// timer interrupt role.
+
+// includes
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Arduino replacements
+
+#define HIGH    1
+#define LOW     0
+
+#define INPUT   0
+#define OUTPUT  1
+
+inline void pinMode(uint8_t pin, uint8_t mode) { (void) pin; (void) mode; }
+inline void digitalWrite(uint8_t pin, uint8_t value) { (void) pin; (void) value; }
+inline int digitalRead(uint8_t pin) { (void) pin; return LOW; }
+inline void delayMicroseconds(unsigned int us) { (void) us; }
+
+// there are no interrupts, the receiver and the timer run from hal polling functions
+inline void noInterrupts(void) {}
+inline void interrupts(void) {}
+
+////////////////////////////////////////////////////////////////////////////////
+// transport
+
+#ifndef HAL_FIFO_SIZE
+#define HAL_FIFO_SIZE   1024
+#endif
+
+// ms a serial write waits for the other side to read before the remaining bytes are dropped
+#ifndef HAL_SERIAL_WRITE_TIMEOUT
+#define HAL_SERIAL_WRITE_TIMEOUT    100
+#endif
+
+// a transport moves the raw (already escaped) bytes between the communication layer and the other side of the link
+typedef struct HAL_TRANSPORT_T {
+    void *ctx;
+    // returns false if the transport couldn't be opened
+    bool (*open)(void *ctx, uint32_t baud_rate);
+    // non blocking, returns how many bytes were read
+    int (*read)(void *ctx, uint8_t *buffer, uint16_t size);
+    // returns how many bytes were written
+    int (*write)(void *ctx, const uint8_t *buffer, uint16_t size);
+} hal_transport_t;
+
+typedef struct HAL_FIFO_T {
+    uint8_t data[HAL_FIFO_SIZE];
+    uint16_t head, tail;
+} hal_fifo_t;
+
+// in memory link, the host side is accessed through hal_loopback_host_read/write
+typedef struct HAL_LOOPBACK_T {
+    hal_fifo_t to_device, from_device;
+} hal_loopback_t;
+
+// tty link, either a real serial port (e.g. an usb to rs-485 adapter) or a pseudo terminal
+typedef struct HAL_SERIAL_T {
+    const char *path;
+    int fd, slave_fd;
+    char pty_name[64];
+} hal_serial_t;
+
+// selects the transport used by comm_init, must be called before it
+void hal_set_transport(hal_transport_t *transport);
+hal_transport_t* hal_get_transport(void);
+
+void hal_loopback_init(hal_loopback_t *loopback, hal_transport_t *transport);
+// queues bytes to be received by the device, returns how many were queued
+int hal_loopback_host_write(hal_loopback_t *loopback, const uint8_t *buffer, uint16_t size);
+// reads bytes sent by the device, returns how many were read
+int hal_loopback_host_read(hal_loopback_t *loopback, uint8_t *buffer, uint16_t size);
+
+// if path is NULL a pseudo terminal is created when the transport is opened, its name is written on pty_name so the
+// host side (e.g. device_test.py) can connect to it
+void hal_serial_init(hal_serial_t *serial, const char *path, hal_transport_t *transport);
+
+////////////////////////////////////////////////////////////////////////////////
+// timer
+
+// the callback is called once per millisecond elapsed
+void hal_timer_attach(void (*tick_cb)(void));
+// advances the simulated time
+void hal_timer_tick(uint32_t ms);
+// advances the time following the system monotonic clock
+void hal_timer_poll(void);
+
+#endif
@@ -0,0 +1 @@
+../impl_actuator/linearsensor.h
\ No newline at end of file
@@ -0,0 +1 @@
+../mode/mode.h
\ No newline at end of file
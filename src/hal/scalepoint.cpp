@@ -0,0 +1 @@
+../scalepoint/scalepoint.cpp
\ No newline at end of file
@@ -0,0 +1,483 @@
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include "config.h"
+#include "hal.h"
+#include "controlchain.h"
+#include "linearsensor.h"
+
+using namespace std;
+
+float get_value = 0;
+
+class ASensor: public LinearSensor{
+public:
+	int samples;
+
+	ASensor(const char* name, uint8_t id):LinearSensor(name, id, 1){
+		samples = 0;
+	}
+
+	reading_t getValue( ){
+		samples++;
+		return get_value;
+	}
+
+};
+
+hal_loopback_t loopback;
+
+#define FUNC_ECHO   0x10
+
+// function registered by the sketch, answers with the received data.
+void echo(Device* dev, uint8_t* message_in){
+	uint16_t data_size = message_in[POS_DATA_SIZE1] | (message_in[POS_DATA_SIZE2] << 8);
+	dev->sendReply(FUNC_ECHO, &message_in[POS_DATA_SIZE2 + 1], data_size);
+}
+
+// writes a frame on the device side of the loopback, escaping it like the host does.
+void hostSend(uint8_t function, const uint8_t* data, uint16_t data_size, uint8_t dest = CHAIN_FIRST_DEV_ADDR){
+	uint8_t header[] = {dest, HOST_ADDRESS, function, (uint8_t)(data_size & 0xFF), (uint8_t)(data_size >> 8)};
+	uint8_t checksum = CHAIN_SYNC_BYTE;
+	uint8_t byte = CHAIN_SYNC_BYTE;
+
+	hal_loopback_host_write(&loopback, &byte, 1);
+
+	for (int i = 0; i < (int)(sizeof(header) + data_size + 1); ++i){
+		if(i < (int)sizeof(header))
+			byte = header[i];
+		else if(i < (int)sizeof(header) + data_size)
+			byte = data[i - sizeof(header)];
+		else
+			byte = checksum;
+
+		checksum += byte;
+
+		if(byte == CHAIN_SYNC_BYTE || byte == CHAIN_ESCAPE_BYTE){
+			uint8_t escaped[] = {CHAIN_ESCAPE_BYTE, (uint8_t)(byte == CHAIN_SYNC_BYTE ? ~CHAIN_SYNC_BYTE : CHAIN_ESCAPE_BYTE)};
+			hal_loopback_host_write(&loopback, escaped, 2);
+		}
+		else{
+			hal_loopback_host_write(&loopback, &byte, 1);
+		}
+	}
+}
+
+void printBytes(const uint8_t* buff, int size){
+	for (int i = 0; i < size; ++i){
+		if((buff[i] >= 'a' && buff[i] <= 'z') || (buff[i] >= 'A' && buff[i] <= 'Z'))
+			printf("%c ", buff[i]);
+		else
+			printf("\\x%02x ", buff[i]);
+	}
+	printf("\n");
+}
+
+// prints what the device sent, returns the number of bytes read.
+int hostPrint(const char* title, bool skip_empty = false){
+	uint8_t buff[512];
+	int size = hal_loopback_host_read(&loopback, buff, sizeof(buff));
+
+	if(!size && skip_empty)
+		return 0;
+
+	printf("%s (%i bytes): ", title, size);
+	printBytes(buff, size);
+
+	return size;
+}
+
+// reads the frame sent by the device, removing the escapes, returns its size.
+int hostRead(uint8_t* frame){
+	uint8_t buff[512];
+	int size = hal_loopback_host_read(&loopback, buff, sizeof(buff));
+	int j = 0;
+
+	for (int i = 0; i < size; ++i){
+		if(buff[i] == CHAIN_ESCAPE_BYTE && i + 1 < size)
+			frame[j++] = (buff[++i] == CHAIN_ESCAPE_BYTE) ? CHAIN_ESCAPE_BYTE : CHAIN_SYNC_BYTE;
+		else
+			frame[j++] = buff[i];
+	}
+
+	return j;
+}
+
+// reads the descriptor request answer, asking the remaining fragments when the descriptor doesn't fit one.
+void hostDescriptor(Device* dev, const char* title){
+	uint8_t frame[512], descriptor[512];
+	int size = 0, fragments = 0;
+
+	while(hostRead(frame)){
+		uint16_t data_size = frame[POS_DATA_SIZE1] | (frame[POS_DATA_SIZE2] << 8);
+		uint8_t* data = &frame[POS_DATA_SIZE2 + 1];
+
+		if(frame[POS_FUNC] != FUNC_DESCRIPTOR_FRAGMENT){
+			memcpy(descriptor, data, data_size);
+			size = data_size;
+			fragments = 1;
+			break;
+		}
+
+		memcpy(&descriptor[size], &data[2], data_size - 2);
+		size += data_size - 2;
+		fragments++;
+
+		if(data[0] + 1 >= data[1])
+			break;
+
+		uint8_t next = data[0] + 1;
+		hostSend(FUNC_DESCRIPTOR_FRAGMENT, &next, 1);
+		dev->run();
+	}
+
+	printf("%s (%i fragments, %i bytes): ", title, fragments, size);
+	printBytes(descriptor, size);
+}
+
+int main(){
+
+	const char url[] = "http://portalmod.com/devices/XP";
+
+	uint8_t _connect[64];
+	uint8_t _control_assig1[] = {0x01,0x00,0x00,0x01,0x00,0x04,'G','a','i','n',0x00,0x00,0x80,0x3F,0x00,0x00,0x00,0x00,0x00,0x00,0x80,0x3F,0x00,0x00,0x00,0x00,0x21,0x00,0x02,'d','B',0x00};
+	uint8_t _data_req[] = {0x00};
+
+	hal_transport_t transport;
+
+	hal_loopback_init(&loopback, &transport);
+	hal_set_transport(&transport);
+
+	Device dev(url, "Testing Device", 1);
+	ControlChain chain;
+	ASensor act1("Knob", 1);
+	ASensor act2("Slow", 2);
+
+	dev.addActuator(&act1);
+	dev.addActuator(&act2);
+	act2.sample_period = 10;
+	dev.registerFunction(FUNC_ECHO, STATE_BIT(WAITING_DATA_REQUEST), echo);
+	chain.init(&dev);
+	dev.init();
+
+	// the connection message is sent after a random delay
+	for (int i = 0; i < RANDOM_CONNECT_RANGE_TOP && !hostPrint("connection", true); ++i){
+		hal_timer_tick(1);
+		dev.run();
+	}
+
+	int url_size = sizeof(url) - 1;
+	_connect[0] = url_size;
+	memcpy(&_connect[1], url, url_size);
+	_connect[url_size + 1] = dev.channel;
+	_connect[url_size + 2] = PROTOCOL_VERSION_BYTE1;
+	_connect[url_size + 3] = PROTOCOL_VERSION_BYTE2;
+	_connect[url_size + 4] = 0x34; // generation token
+	_connect[url_size + 5] = 0x12;
+
+	hostSend(FUNC_CONNECTION, _connect, url_size + 6);
+	dev.run();
+	cout << "state: " << (int) dev.state << " id: " << (int) dev.id << endl;
+
+	hostSend(FUNC_DEVICE_DESCRIPTOR, 0, 0);
+	dev.run();
+	hostDescriptor(&dev, "descriptor");
+	cout << "state: " << (int) dev.state << endl;
+
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _control_assig1, sizeof(_control_assig1));
+	dev.run();
+	hostPrint("assignment");
+
+	get_value = 512;
+	dev.run();
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("data request");
+
+	// nothing changed, so no update is sent
+	dev.run();
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("data request");
+
+	// push mode, changes go without a data request on the window granted by the host: 2 ms from the start of each 5 ms
+	uint8_t _push_mode[] = {0x05, 0x00, 0x00, 0x00, 0x02, 0x00};
+	hostSend(FUNC_PUSH_MODE, _push_mode, sizeof(_push_mode));
+	dev.run();
+	hostPrint("push mode");
+
+	get_value = 1023;
+	dev.run();
+	hostPrint("push");
+	hostSend(FUNC_DATA_PUSH, 0, 0);
+	dev.run();
+	hostPrint("push ack");
+
+	get_value = 0;
+	dev.run();
+	hostPrint("push (window used)");
+
+	hal_timer_tick(3);
+	dev.run();
+	hostPrint("push (out of the window)");
+
+	hal_timer_tick(2);
+	dev.run();
+	hostPrint("push");
+
+	// not acknowledged, sent again on the next window
+	hal_timer_tick(5);
+	dev.run();
+	hostPrint("push (again)");
+	hostSend(FUNC_DATA_PUSH, 0, 0);
+	dev.run();
+
+	uint8_t _push_off[] = {0x00, 0x00};
+	hostSend(FUNC_PUSH_MODE, _push_off, sizeof(_push_off));
+	dev.run();
+	hostPrint("push mode");
+
+	uint8_t _echo[] = {'p', 'i', 'n', 'g'};
+	hostSend(FUNC_ECHO, _echo, sizeof(_echo));
+	dev.run();
+	hostPrint("echo");
+
+	// compact values, the assignment has 33 steps so the value goes as the step position in 1 byte
+	uint8_t _compact[] = {VALUE_ENCODING_COMPACT};
+	hostSend(FUNC_VALUE_ENCODING, _compact, sizeof(_compact));
+	dev.run();
+	hostPrint("value encoding");
+
+	get_value = 512;
+	dev.run();
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("data request");
+
+	// the link goes silent, the device reconnects advertising the generation and the host resumes it
+	hal_timer_tick(DEVICE_TIMEOUT_PERIOD);
+	dev.run();
+	cout << "timeout state: " << (int) dev.state << endl;
+	for (int i = 0; i < RANDOM_CONNECT_RANGE_TOP && !hostPrint("reconnection", true); ++i){
+		hal_timer_tick(1);
+		dev.run();
+	}
+	hostSend(FUNC_CONNECTION, _connect, url_size + 6);
+	dev.run();
+	cout << "state: " << (int) dev.state << " assignments: " << (int) act1.assignments_occupied << endl;
+
+	// the resumed generation keeps the compact values
+	get_value = 256;
+	dev.run();
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("resumed data request");
+
+	uint8_t _control_unassig1[] = {0x01};
+	hostSend(FUNC_CONTROL_UNASSIGNMENT, _control_unassig1, sizeof(_control_unassig1));
+	dev.run();
+	hostPrint("unassignment");
+	cout << "assignments: " << (int) act1.assignments_occupied << endl;
+
+	// the host lost the state, so it gives another generation and the assignments are dropped
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _control_assig1, sizeof(_control_assig1));
+	dev.run();
+	hostPrint("assignment");
+	hal_timer_tick(DEVICE_TIMEOUT_PERIOD);
+	dev.run();
+	for (int i = 0; i < RANDOM_CONNECT_RANGE_TOP && !hostPrint("reconnection", true); ++i){
+		hal_timer_tick(1);
+		dev.run();
+	}
+	_connect[url_size + 4] = 0x21;
+	_connect[url_size + 5] = 0x43;
+	hostSend(FUNC_CONNECTION, _connect, url_size + 6);
+	dev.run();
+	cout << "state: " << (int) dev.state << " assignments: " << (int) act1.assignments_occupied << endl;
+
+	// the slow sensor is only sampled once every 10 ms, however fast the loop runs
+	uint8_t _control_assig2[sizeof(_control_assig1)];
+	memcpy(_control_assig2, _control_assig1, sizeof(_control_assig1));
+	_control_assig2[0] = 0x02; // actuator id
+	_control_assig2[3] = 0x02; // assignment id
+	hostSend(FUNC_DEVICE_DESCRIPTOR, 0, 0);
+	dev.run();
+	hostDescriptor(&dev, "descriptor");
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _control_assig2, sizeof(_control_assig2));
+	dev.run();
+	hostPrint("assignment");
+
+	act2.samples = 0;
+	for (int i = 0; i < 100; ++i){
+		if(i % 4 == 0)
+			hal_timer_tick(1);
+		dev.run();
+	}
+	cout << "samples in 100 runs / 25 ms: " << act2.samples << endl;
+
+	// both actuators change and only one update fits a frame (FRAGMENT_SIZE on the Makefile), the host asks the
+	// second fragment, then asks it again as if it was lost
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _control_assig1, sizeof(_control_assig1));
+	dev.run();
+	hostPrint("assignment");
+
+	get_value = 300;
+	hal_timer_tick(10);
+	dev.run();
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("data fragment");
+
+	uint8_t _fragment[] = {0x01};
+	hostSend(FUNC_DATA_FRAGMENT, _fragment, sizeof(_fragment));
+	dev.run();
+	hostPrint("data fragment");
+	hostSend(FUNC_DATA_FRAGMENT, _fragment, sizeof(_fragment));
+	dev.run();
+	hostPrint("data fragment (again)");
+
+	_fragment[0] = 0x02;
+	hostSend(FUNC_DATA_FRAGMENT, _fragment, sizeof(_fragment));
+	dev.run();
+	hostPrint("data fragment (out of range)");
+
+	// nothing left to send
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("data request");
+
+	// both assignments made again in one frame, with a record for an actuator that doesn't exist and a truncated one
+	uint8_t _unassig2[] = {0x02};
+	hostSend(FUNC_CONTROL_UNASSIGNMENT, _control_unassig1, sizeof(_control_unassig1));
+	hostSend(FUNC_CONTROL_UNASSIGNMENT, _unassig2, sizeof(_unassig2));
+	dev.run();
+	hostPrint("unassignments");
+
+	uint8_t _bulk[1 + 3*sizeof(_control_assig1) + 2];
+	int bulk_size = 0;
+	_bulk[bulk_size++] = 4;
+	memcpy(&_bulk[bulk_size], _control_assig1, sizeof(_control_assig1));
+	bulk_size += sizeof(_control_assig1);
+	memcpy(&_bulk[bulk_size], _control_assig2, sizeof(_control_assig2));
+	bulk_size += sizeof(_control_assig2);
+	memcpy(&_bulk[bulk_size], _control_assig2, sizeof(_control_assig2));
+	_bulk[bulk_size] = 0x09; // actuator id
+	bulk_size += sizeof(_control_assig2);
+	_bulk[bulk_size++] = 0x01;
+	_bulk[bulk_size++] = 0x00;
+	hostSend(FUNC_BULK_ASSIGNMENT, _bulk, bulk_size);
+	dev.run();
+	hostPrint("bulk assignment");
+	cout << "assignments: " << (int) act1.assignments_occupied << " " << (int) act2.assignments_occupied << endl;
+
+	// the device asks the host some assignments, they go on the next data request response only
+	dev.requestAssignment(0x05);
+	dev.requestAssignment(0x07);
+	dev.requestAssignment(0x05);
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("data request with assignment requests");
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req));
+	dev.run();
+	hostPrint("data request");
+
+	// the scale points of an assignment take consecutive entries of their bank (MAX_SCALE_POINTS on the Makefile). With
+	// the bank fragmented an assignment fails even if there are enough free entries, and the host is told so.
+	uint8_t _scale_points[sizeof(_control_assig1) + 3*(1 + 2 + sizeof(float))];
+	int sp_size = sizeof(_control_assig1) - 1;
+	float sp_value = 0;
+	memcpy(_scale_points, _control_assig1, sp_size);
+	_scale_points[sp_size++] = 3;
+	for (int i = 0; i < 3; ++i, sp_value += 0.5){
+		_scale_points[sp_size++] = 2;
+		_scale_points[sp_size++] = 'p';
+		_scale_points[sp_size++] = '0' + i;
+		memcpy(&_scale_points[sp_size], &sp_value, sizeof(float));
+		sp_size += sizeof(float);
+	}
+
+	hostSend(FUNC_CONTROL_UNASSIGNMENT, _control_unassig1, sizeof(_control_unassig1));
+	hostSend(FUNC_CONTROL_UNASSIGNMENT, _unassig2, sizeof(_unassig2));
+	dev.run();
+	hostPrint("unassignments");
+
+	// entries 0 and 1 for the first assignment, 2 for the second, then the first is freed: 3 entries free, 2 in a row
+	int sp_count_pos = sizeof(_control_assig1) - 1;
+	int sp_record_size = 1 + 2 + sizeof(float);
+	uint8_t _scale_points2[sizeof(_control_assig1) + 1*(1 + 2 + sizeof(float))];
+	memcpy(_scale_points2, _scale_points, sizeof(_scale_points2));
+	_scale_points2[0] = 0x02; // actuator id
+	_scale_points2[3] = 0x02; // assignment id
+	_scale_points2[sp_count_pos] = 1;
+	_scale_points[sp_count_pos] = 2;
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _scale_points, sizeof(_control_assig1) + 2*sp_record_size);
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _scale_points2, sizeof(_scale_points2));
+	dev.run();
+	hostSend(FUNC_CONTROL_UNASSIGNMENT, _control_unassig1, sizeof(_control_unassig1));
+	dev.run();
+	hostPrint("scale point assignments and unassignment");
+
+	_scale_points[sp_count_pos] = 3;
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _scale_points, sp_size);
+	dev.run();
+	uint8_t frame[512];
+	int frame_size = hostRead(frame);
+	printf("assignment (scale points bank fragmented) (%i bytes): ", frame_size);
+	printBytes(frame, frame_size);
+	if(frame_size < POS_DATA_SIZE2 + 3 || frame[POS_FUNC] != FUNC_CONTROL_ASSIGNMENT ||
+		(int16_t)(frame[POS_DATA_SIZE2 + 1] | (frame[POS_DATA_SIZE2 + 2] << 8)) != -1){
+		cout << "the assignment should have failed" << endl;
+		return 1;
+	}
+	pool_stats_t points = ScalePointList::poolStats();
+	cout << "assignments: " << (int) act1.assignments_occupied << " " << (int) act2.assignments_occupied;
+	cout << " scale points used: " << points.used << " failures: " << points.failures << endl;
+
+	// the assignments are made again as they were
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _control_assig1, sizeof(_control_assig1));
+	hostSend(FUNC_CONTROL_ASSIGNMENT, _control_assig2, sizeof(_control_assig2));
+	dev.run();
+	hostPrint("assignments");
+	cout << "assignments: " << (int) act1.assignments_occupied << " " << (int) act2.assignments_occupied << endl;
+
+	// slots move between actuators at runtime, the assigned ones stay
+	cout << "free slots: " << Actuator::freeSlots();
+	cout << " grow: " << dev.setAssignmentSlots(&act1, 2) << " free slots: " << Actuator::freeSlots();
+	cout << " bank empty: " << dev.setAssignmentSlots(&act2, 2);
+	cout << " below assigned: " << dev.setAssignmentSlots(&act1, 0);
+	cout << " shrink: " << dev.setAssignmentSlots(&act1, 1);
+	act1.init();
+	cout << " free slots after init: " << Actuator::freeSlots() << " slots: " << (int) act1.num_assignments << " " << (int) act2.num_assignments << endl;
+
+	// the bank counts the most slots taken and the slots it couldn't give
+	pool_stats_t slots = Actuator::slotPoolStats();
+	cout << "slot pool capacity: " << slots.capacity << " used: " << slots.used << " high water: " << slots.high_water;
+	cout << " failures: " << slots.failures << endl;
+
+	// a second device with another channel shares the link, each one answers its own address
+	Device dev2(url, "Second Device", 2);
+	ASensor act3("Knob", 1);
+
+	chain.addDevice(&dev2);
+	dev2.addActuator(&act3);
+	dev2.init();
+
+	for (int i = 0; i < RANDOM_CONNECT_RANGE_TOP && !hostPrint("connection", true); ++i){
+		hal_timer_tick(1);
+		dev2.run();
+	}
+	_connect[url_size + 1] = dev2.channel;
+	hostSend(FUNC_CONNECTION, _connect, url_size + 6, CHAIN_FIRST_DEV_ADDR + 1);
+	dev2.run();
+	cout << "state: " << (int) dev2.state << " id: " << (int) dev2.id << " first device state: " << (int) dev.state << endl;
+
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req), CHAIN_FIRST_DEV_ADDR + 1);
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req), CHAIN_FIRST_DEV_ADDR);
+	hostSend(FUNC_DATA_REQUEST, _data_req, sizeof(_data_req), CHAIN_FIRST_DEV_ADDR + 2);
+	dev.run();
+	hostPrint("data requests to 0x81, 0x80 and 0x82");
+
+	cout << "rx overflows: " << comm_rx_overflows() << endl;
+
+	return 0;
+}
@@ -1,5 +1,9 @@
 #include "button.h"
 
+// the actuator would describe only the first ones
+static_assert(BUTTON_NUM_MODES <= MAX_ACTUATOR_MODES, "Button modes don't fit MAX_ACTUATOR_MODES.");
+static_assert(BUTTON_NUM_STEPS <= MAX_STEPS_COUNT, "Button steps don't fit MAX_STEPS_COUNT.");
+
 float convert_to_ms(Str unit_from, float value)
 {
     char unit[8];
@@ -85,6 +89,10 @@ Button::Button(const char* name, uint8_t id, uint8_t num_assignments, int deboun
     this->saved_state = 0;
     this->tap_state = 0;
 
+    this->limits_assig = 0;
+    this->value_minimum = 0;
+    this->value_maximum = 0;
+
     this->timer_debounce.setPeriod(debounce_delay);
 }
 
@@ -103,15 +111,14 @@ void Button::calculateValue(){
         return;
     }
 
-    float scaleMin, scaleMax;
-
-    scaleMin = this->current_assig->minimum;
-    scaleMax = this->current_assig->maximum;
-
     counter_t tap_time;
 
     bool changed_button_state = 0;
 
+    // nextAssignment() and previousAssignment() change the assignment too
+    if(this->current_assig != this->limits_assig)
+        updateLimits();
+
     if(debounce()){
         changed_button_state = 1;
         this->saved_state ^= 1;
@@ -120,14 +127,14 @@ void Button::calculateValue(){
 
     if(this->current_assig->mode == *(this->butt_modes[1])){
         if(this->saved_state)
-            this->value = scaleMax;
+            this->value = this->value_maximum;
     }
 
     else if(this->current_assig->mode == *(this->butt_modes[0])){
         if(this->saved_state)
-            this->value = scaleMax;
+            this->value = this->value_maximum;
         else
-            this->value = scaleMin;
+            this->value = this->value_minimum;
     }
 
     else if(this->current_assig->mode == *(this->butt_modes[2])){
@@ -149,12 +156,14 @@ void Button::calculateValue(){
                 // timer_tap_led.setPeriod(tap_time);
                 // timer_tap_led.start();
 
-                this->value = convert_from_ms(this->current_assig->unit, tap_time);
+                float tempo = convert_from_ms(this->current_assig->unit, tap_time);
+
+                if(tempo > this->current_assig->maximum)
+                    tempo = this->current_assig->maximum;
+                else if(tempo < this->current_assig->minimum)
+                    tempo = this->current_assig->minimum;
 
-                if(this->value > scaleMax)
-                    this->value = scaleMax;
-                else if(this->value < scaleMin)
-                    this->value = scaleMin;
+                this->value = VALUE_FROM_FLOAT(tempo);
 
             }
         }
@@ -177,10 +186,22 @@ void Button::postMessageChanges(){
     }
 }
 
+// the limits are taken on every sample, so they are converted only when the assignment changes.
+void Button::updateLimits(){
+    this->limits_assig = this->current_assig;
+    if(!this->current_assig)
+        return;
+
+    this->value_minimum = VALUE_FROM_FLOAT(this->current_assig->minimum);
+    this->value_maximum = VALUE_FROM_FLOAT(this->current_assig->maximum);
+}
+
 // Possible rotine to be executed after the message is sent.
 void Button::assignmentRotine(){
+    updateLimits();
+
     if(this->current_assig->mode == *(this->butt_modes[0])){
-        if(this->value - this->current_assig->maximum < VALUE_CHANGE_TOLERANCE)
+        if(VALUE_TO_FLOAT(this->value) - this->current_assig->maximum < VALUE_CHANGE_TOLERANCE)
             this->saved_state = 1;
         else
             this->saved_state = 0;
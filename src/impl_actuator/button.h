@@ -37,6 +37,10 @@ public:
     bool            tap_state;
     float           tap_tempo_limit;
 
+    Assignment*     limits_assig;           // assignment the value limits were converted for
+    value_t         value_minimum;          // assignment minimum and maximum as values, converted once
+    value_t         value_maximum;
+
     STimer          timer_debounce;
     STimer          timer_tap;
 
@@ -57,8 +61,11 @@ public:
     // checks if the button state changed doing a debounce.
     bool debounce();
 
+    // converts the current assignment minimum and maximum to values.
+    void updateLimits();
+
     // this function needs to be implemented by the user.
-    virtual float getValue()=0;
+    virtual reading_t getValue()=0;
 
 };
 
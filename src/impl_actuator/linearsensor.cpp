@@ -1,9 +1,24 @@
 #include "linearsensor.h"
 
+// the actuator would describe only the first ones
+static_assert(LS_NUM_MODES <= MAX_ACTUATOR_MODES, "LinearSensor modes don't fit MAX_ACTUATOR_MODES.");
+static_assert(LS_NUM_STEPS <= MAX_STEPS_COUNT, "LinearSensor steps don't fit MAX_STEPS_COUNT.");
+
 LinearSensor::LinearSensor(const char* name, uint8_t id, uint8_t num_assignments): Actuator(name, id, num_assignments, lin_modes, LS_NUM_MODES, lin_steps, LS_NUM_STEPS){
     this->minimum = 0;
     this->maximum = 1023;
 
+    this->transfer_assig = 0;
+    this->slope = 0;
+    this->offset = 0;
+#ifdef FIXED_POINT_VALUES
+    this->slope_fixed = 0;
+    this->slope_shift = 0;
+    this->slope_round = 0;
+    this->offset_fixed = 0;
+    this->slope_wide = false;
+#endif
+
     this->lin_modes[0] = Mode::registerMode("linear",0,0);
 
     this->lin_steps[0] = 17;
@@ -12,37 +27,124 @@ LinearSensor::LinearSensor(const char* name, uint8_t id, uint8_t num_assignments
 }
 LinearSensor::~LinearSensor(){}
 
+#ifdef FIXED_POINT_VALUES
+// 2^x as 2^floor(x) times the same cubic of LS_FAST_EXP2, with the coefficients in Q0.16. Saturates above 32767.
+static value_t fixedExp2(value_t x){
+    int32_t whole = x >> 16;
+    uint32_t f = x & 0xFFFF;
+    uint32_t p;
+
+    p = (5206 * f) >> 16;
+    p = ((14712 + p) * f) >> 16;
+    p = ((45617 + p) * f) >> 16;
+    p += VALUE_ONE;
+
+    // p is below 2.0, so from whole 14 on the shift may not fit int32_t, it's done in 64 bits and clamped.
+    if (whole >= 15)
+        return 0x7FFFFFFF;
+    if (whole >= 0){
+        uint64_t r = (uint64_t) p << whole;
+        return (r > 0x7FFFFFFF) ? 0x7FFFFFFF : (value_t) r;
+    }
+    if (whole > -32)
+        return p >> -whole;
+    return 0;
+}
+#elif defined(LS_FAST_EXP2)
+// 2^x as 2^floor(x) times a cubic fit of 2^f on [0, 1).
+static float fastExp2(float x){
+    float whole = floor(x);
+    float f = x - whole;
+
+    return ldexp(1 + f*(0.6960656f + f*(0.2244943f + f*0.0794402f)), (int) whole);
+}
+#endif
+
 // this function works with the value got from the sensor, it makes some calculations over this value and
 // feeds the result to a Update class.
 void LinearSensor::calculateValue(){
-    float sensor = this->getValue();
+    reading_t sensor = this->getValue();
 
-    float scaleMin, scaleMax;
-
-    scaleMin = this->current_assig->minimum;
-    scaleMax = this->current_assig->maximum;
+    // nextAssignment() and previousAssignment() change the assignment too
+    if (this->current_assig != this->transfer_assig)
+        assignmentRotine();
 
     // Convert the sensor scale to the parameter scale
-    if (this->current_assig->port_properties & MODE_PROPERTY_LOGARITHM) {
-        scaleMin = log(scaleMin)/log(2);
-        scaleMax = log(scaleMax)/log(2);
-    }
-
-    // Parameter is linear
-    this->value = (sensor - this->minimum) * (this->current_assig->maximum - this->current_assig->minimum);
-    this->value /= (this->maximum - this->minimum);
-    this->value += this->current_assig->minimum;
+#ifdef FIXED_POINT_VALUES
+    // the integer reading times the slope has 16 + slope_shift fraction bits, the multiply is 32 bits wide unless the
+    // sensor range and slope don't allow it.
+    if (!this->slope_wide)
+        this->value = this->offset_fixed + ((sensor * this->slope_fixed + this->slope_round) >> this->slope_shift);
+    else
+        this->value = this->offset_fixed +
+            (value_t) (((int64_t) sensor * this->slope_fixed + this->slope_round) >> this->slope_shift);
+#else
+    this->value = sensor * this->slope + this->offset;
+#endif
 
     if (this->current_assig->port_properties & MODE_PROPERTY_LOGARITHM) {
-        this->value = pow(2,this->value);
+#ifdef FIXED_POINT_VALUES
+        this->value = fixedExp2(this->value);
+#elif defined(LS_FAST_EXP2)
+        this->value = fastExp2(this->value);
+#else
+        this->value = exp(this->value * M_LN2);
+#endif
     }
 
     if (this->current_assig->port_properties & MODE_PROPERTY_INTEGER) {
+#ifdef FIXED_POINT_VALUES
+        this->value &= ~(VALUE_ONE - 1);
+#else
         this->value = floor(this->value);
+#endif
+    }
+
+    // Enumerations only take the scale points values
+    if (this->current_assig->port_properties & MODE_PROPERTY_ENUMERATION) {
+        int sp = this->current_assig->nearestScalePoint(VALUE_TO_FLOAT(this->value));
+
+        if (sp >= 0)
+            this->value = VALUE_FROM_FLOAT(this->current_assig->scale_points.getValue(sp));
     }
 }
 
 // Possible rotine to be executed after the message is sent.
 void LinearSensor::postMessageChanges(){}
 
-void LinearSensor::assignmentRotine(){}
\ No newline at end of file
+// the transfer only changes with the assignment, so the divisions and logarithms run here and calculateValue() is
+// left with a multiply-add.
+void LinearSensor::assignmentRotine(){
+    float scaleMin, scaleMax;
+
+    this->transfer_assig = this->current_assig;
+    if (!this->current_assig)
+        return;
+
+    scaleMin = this->current_assig->minimum;
+    scaleMax = this->current_assig->maximum;
+
+    // Logarithmic parameters vary linearly on log2 scale
+    if (this->current_assig->port_properties & MODE_PROPERTY_LOGARITHM) {
+        scaleMin = log(scaleMin)/log(2);
+        scaleMax = log(scaleMax)/log(2);
+    }
+
+    this->slope = (scaleMax - scaleMin) / (this->maximum - this->minimum);
+    this->offset = scaleMin - this->minimum * this->slope;
+
+#ifdef FIXED_POINT_VALUES
+    // the slope keeps as many fraction bits as fit, small slopes (e.g. a 0 to 1 parameter on a 10 bits sensor) would
+    // lose most of their digits on Q16.16. The product with the reading is shifted back by slope_shift. Readings up to
+    // twice the sensor range are kept within 32 bits, if no shift allows it the product is taken on 64 bits.
+    float reading_max = 2 * fmax(fabs(this->minimum), fabs(this->maximum));
+
+    this->offset_fixed = VALUE_FROM_FLOAT(this->offset);
+    this->slope_shift = 14;
+    while (this->slope_shift > 0 && fabs(ldexp(this->slope, 16 + this->slope_shift)) * reading_max >= 2147483647.0)
+        this->slope_shift--;
+    this->slope_wide = (fabs(ldexp(this->slope, 16 + this->slope_shift)) * reading_max >= 2147483647.0);
+    this->slope_fixed = (int32_t) floor(ldexp(this->slope, 16 + this->slope_shift) + 0.5);
+    this->slope_round = this->slope_shift ? (int32_t) 1 << (this->slope_shift - 1) : 0;
+#endif
+}
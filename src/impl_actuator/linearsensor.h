@@ -8,6 +8,9 @@
 #define LS_NUM_MODES 1
 #define LS_NUM_STEPS 3
 
+// define it to compute logarithmic values with a polynomial instead of exp(), the error is under 0.02%
+// #define LS_FAST_EXP2
+
 /*
 ************************************************************************************************************************
 This class works like a preset to an actuator. It describes a sensor that varies linearly.
@@ -19,6 +22,17 @@ public:
     float           minimum;
     float           maximum;
 
+    Assignment*     transfer_assig;     // assignment the slope and offset were computed for
+    float           slope;              // parameter units (log2 of them on logarithmic ports) per sensor unit
+    float           offset;
+#ifdef FIXED_POINT_VALUES
+    int32_t         slope_fixed;        // slope with 16 + slope_shift fraction bits
+    uint8_t         slope_shift;
+    int32_t         slope_round;        // half of the last bit shifted out, so the product is rounded
+    value_t         offset_fixed;
+    bool            slope_wide;         // the reading times slope_fixed may not fit 32 bits, it's multiplied in 64
+#endif
+
     Mode*           lin_modes[LS_NUM_MODES];
     uint16_t        lin_steps[LS_NUM_STEPS];
 
@@ -33,11 +47,12 @@ public:
     // Possible rotine to be executed after the message is sent.
     void postMessageChanges();
 
-    // Rotine that runs when a parameter is assigned to the actuator.
+    // Rotine that runs when a parameter is assigned to the actuator, it computes the sensor to parameter transfer.
+    // Run it again if minimum or maximum change while assigned.
     void assignmentRotine();
 
     // this function needs to be implemented by the user.
-    virtual float getValue()=0;
+    virtual reading_t getValue()=0;
 
 };
 
@@ -0,0 +1 @@
+../pool/pool.h
\ No newline at end of file
@@ -11,6 +11,9 @@
 #define MAX_MODE_LABEL_SIZE     5
 #endif
 
+// relevant_properties (1) + property_values (1) + label_length (1) + label (n)
+#define MODE_DESCRIPTOR_MAX_SIZE    (3 + MAX_MODE_LABEL_SIZE)
+
 
 /*
 ************************************************************************************************************************
@@ -0,0 +1,126 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+
+#define POOL_WORDS(n)   (((n) + 31) / 32)
+
+// usage counters of a pool, to size its capacity on the real device.
+typedef struct POOL_STATS_T {
+    int         capacity;
+    int         used;
+    int         high_water;             // most items taken at the same time
+    uint16_t    failures;               // allocations that found the pool full
+} pool_stats_t;
+
+// Fixed capacity pool of N items of T. The taken items are kept on a bitmap, a free item is found by the first zero
+// bit of the first word not full, so alloc and free take the same time wherever the item is on the pool.
+template <typename T, int N>
+class Pool{
+
+public:
+    T           items[N];
+    uint32_t    used_map[POOL_WORDS(N)];    // bit i is set while items[i] is taken
+    int         used;
+    int         high_water;
+    uint16_t    failures;
+
+    Pool(){
+        for (int w = 0; w < POOL_WORDS(N); ++w){
+            used_map[w] = 0;
+        }
+
+        // the bits past the last item are taken so they are never found free
+        if(N % 32)
+            used_map[POOL_WORDS(N) - 1] = ~(((uint32_t) 1 << (N % 32)) - 1);
+
+        used = 0;
+        high_water = 0;
+        failures = 0;
+    }
+    ~Pool(){}
+
+    // returns a free item or null if the pool is full.
+    T* alloc(){
+        for (int w = 0; w < POOL_WORDS(N); ++w){
+            uint32_t free_bits = ~used_map[w];
+
+            if(free_bits){
+                int i = __builtin_ctzl(free_bits);
+
+                used_map[w] |= (uint32_t) 1 << i;
+                if(++used > high_water)
+                    high_water = used;
+
+                return &items[w*32 + i];
+            }
+        }
+
+        failures++;
+        return 0;
+    }
+
+    // gives back an item, items not taken from this pool are ignored.
+    void free(T* item){
+        int i = indexOf(item);
+
+        if(i < 0 || !(used_map[i / 32] & ((uint32_t) 1 << (i % 32))))
+            return;
+
+        used_map[i / 32] &= ~((uint32_t) 1 << (i % 32));
+        used--;
+    }
+
+    // returns the first of count consecutive free items or null if there is no such run. The items are searched one by
+    // one, it's meant for setups, not for the hot paths.
+    T* allocRun(int count){
+        int run = 0;
+
+        for (int i = 0; i < N && count > 0; ++i){
+            if(used_map[i / 32] & ((uint32_t) 1 << (i % 32))){
+                run = 0;
+            }
+            else if(++run == count){
+                for (int j = i - count + 1; j <= i; ++j){
+                    used_map[j / 32] |= (uint32_t) 1 << (j % 32);
+                }
+
+                used += count;
+                if(used > high_water)
+                    high_water = used;
+
+                return &items[i - count + 1];
+            }
+        }
+
+        failures++;
+        return 0;
+    }
+
+    // gives back count items from item on.
+    void freeRun(T* item, int count){
+        while(count--){
+            free(item++);
+        }
+    }
+
+    // returns the item position on the pool or -1 if it isn't part of it.
+    int indexOf(const T* item){
+        if(!item || item < &items[0] || item >= &items[0] + N)
+            return -1;
+
+        return item - &items[0];
+    }
+
+    int getFreeSpace(){
+        return N - used;
+    }
+
+    pool_stats_t getStats(){
+        pool_stats_t stats = {N, used, high_water, failures};
+        return stats;
+    }
+
+};
+
+#endif
@@ -0,0 +1,5 @@
+// sizes for the scale point module test, the library ones are on src/config.h
+
+#define MAX_SCALE_POINTS    8
+#define MAX_STRING_SIZE     6
+#define MAX_STRING_COUNT    4
@@ -1,100 +1,117 @@
 #include <stdint.h>
+#include <string.h>
 #include "str.h"
 #include "scalepoint.h"
 
-class FloatBank
+class ScalePointBank
 {
 public:
-    float bank[MAX_FLOAT_COUNT]; // array containing all floats used by scalepoints in the program.
-    bool occupied[MAX_FLOAT_COUNT]; // array stating which float is occupied.
+    Pool<float, MAX_SCALE_POINTS> pool;                 // values of all scalepoints in the program.
+    char    labels[MAX_SCALE_POINTS][MAX_STRING_SIZE];  // label arena, the label of pool.items[i] is on labels[i].
+    uint8_t label_sizes[MAX_SCALE_POINTS];
 
-    FloatBank(){
-        for (int i = 0; i < MAX_FLOAT_COUNT; ++i){
-            occupied[i] = false;
-        }
-    }
-    ~FloatBank(){}
-
-    float* allocFloat(){
-        for(int i = 0; i < MAX_FLOAT_COUNT; ++i){
-            if(!occupied[i]){
-                occupied[i] = true;
-                return (float*) &bank[i];
-            }
-        }
-        return 0;
-    }
+    ScalePointBank(){}
+    ~ScalePointBank(){}
 
-    void freeFloat(float* value){
-        int index;
+};
+static ScalePointBank spBank;
 
-        if(!value){
-            return;
-        }
 
-        index = (value-&bank[0]);
+ScalePointList::ScalePointList(){
+    this->values = 0; //NULL
+    this->capacity = 0;
+    this->count = 0;
+}
 
-        if(index >= 0 && index < MAX_FLOAT_COUNT){
-            occupied[index] = false;
-        }
+ScalePointList::~ScalePointList(){}
 
+bool ScalePointList::alloc(int size){
+    free();
+
+    if(size <= 0){
+        return true;
     }
 
-};
-static FloatBank floatBank;
+    this->values = spBank.pool.allocRun(size);
+    if(!this->values)
+        return false;
 
+    this->capacity = size;
+    return true;
+}
+
+void ScalePointList::free(){
+    if(this->values){
+        spBank.pool.freeRun(this->values, this->capacity);
+    }
 
-ScalePoint::ScalePoint(){
-    this->value = 0; //NULL
-    this->next = 0; //NULL
-    this->previous = 0; //NULL
+    this->values = 0;
+    this->capacity = 0;
+    this->count = 0;
 }
 
-ScalePoint::~ScalePoint(){}
+// insertion keeps the list sorted, it only runs while the assignment is set up.
+bool ScalePointList::add(const char* label, int label_size, float value){
+    int first, i;
 
-bool ScalePoint::allocScalePoint(){
-    this->label.allocStr();
-    this->value = floatBank.allocFloat();
+    if(this->count >= this->capacity){
+        return false;
+    }
 
+    first = spBank.pool.indexOf(this->values);
+    label_size = (label_size < MAX_STRING_SIZE) ? label_size : MAX_STRING_SIZE;
 
-    if(this->value)
-        return true;
-    return false;
-}
+    for (i = this->count; i > 0 && this->values[i - 1] > value; --i){
+        this->values[i] = this->values[i - 1];
+        memcpy(spBank.labels[first + i], spBank.labels[first + i - 1], MAX_STRING_SIZE);
+        spBank.label_sizes[first + i] = spBank.label_sizes[first + i - 1];
+    }
 
-void ScalePoint::freeScalePoint(){
-    this->label.freeStr();
-    floatBank.freeFloat(this->value);
-}
+    this->values[i] = value;
+    memcpy(spBank.labels[first + i], label, label_size);
+    spBank.label_sizes[first + i] = label_size;
 
-bool ScalePoint::setLabel(const char* text, int length){
-    return this->label.setText(text, length);
+    this->count++;
+    return true;
 }
 
-void ScalePoint::setValue(const uint8_t* first_byte){
-    *(this->value) = (float) *((float*) (first_byte));
-}
+int ScalePointList::nearest(float value){
+    int low = 0, high = this->count - 1;
 
-int ScalePoint::getLabel(char* buffer, int buffer_size){
-    return this->label.getText(buffer,buffer_size);
-}
+    if(!this->count){
+        return -1;
+    }
 
-float ScalePoint::getValue(){
-    return *this->value;
-}
+    // bisects until low and high are the values around value
+    while(high - low > 1){
+        int middle = (low + high) / 2;
 
-ScalePoint* ScalePoint::getNext(){
-    return this->next;
+        if(this->values[middle] > value)
+            high = middle;
+        else
+            low = middle;
+    }
+
+    return (value - this->values[low] <= this->values[high] - value) ? low : high;
 }
 
-void ScalePoint::setNext(ScalePoint* next){
-    this->next = next;
+float ScalePointList::getValue(int i){
+    return this->values[i];
 }
 
-ScalePoint* ScalePoint::getPrevious(){
-    return this->previous;
+int ScalePointList::getLabel(int i, char* buffer, int buffer_size){
+    int index = spBank.pool.indexOf(this->values) + i;
+    int len = spBank.label_sizes[index];
+
+    if(buffer_size && buffer_size < len){
+        len = buffer_size;
+    }
+
+    memcpy(buffer, spBank.labels[index], len);
+
+    return len;
 }
 
-void ScalePoint::setPrevious(ScalePoint* previous){
-    this->previous = previous;
-}
\ No newline at end of file
+pool_stats_t ScalePointList::poolStats(){
+    return spBank.pool.getStats();
+}
@@ -4,58 +4,50 @@
 #include "config.h"
 #include <stdint.h>
 #include "str.h"
+#include "pool.h"
 
-#ifndef MAX_FLOAT_COUNT
-#define MAX_FLOAT_COUNT 100
+// size of scalepoint bank
+#ifndef MAX_SCALE_POINTS
+#define MAX_SCALE_POINTS 10
 #endif
 
 /*
 ************************************************************************************************************************
-This class holds Scale points information, it's contained on an actuator.
+This class holds the scale points of an assignment. They take consecutive entries of the scale point bank sorted by
+value, so the values are next to each other on one float array and the labels on the label arena at the same positions.
 ************************************************************************************************************************
 */
-class ScalePoint{
+class ScalePointList{
 public:
-    Str         label;      // scalepoint label
-    float*      value;      // scalepoint value
-    ScalePoint* next;       // pointer to next scalepoint, if this SP is the last of the list, next = NULL
-    ScalePoint* previous;   // pointer to previous scale point, if this SP is the first of the list, previous = NULL
+    float*  values;     // first value on the bank, null if the list has no entries
+    int     capacity;   // entries taken from the bank
+    int     count;      // scale points written on them
 
-    ScalePoint();
+    ScalePointList();
 
-    ~ScalePoint();
+    ~ScalePointList();
 
-    // allocate a SP from spBank.
-    // returns false in case there are no more floats on floatBank to point.
-    bool allocScalePoint();
+    // takes size consecutive entries from the bank.
+    // returns false in case the bank has no free run that long.
+    bool alloc(int size);
 
-    // Set free SP pointed.
-    void freeScalePoint();
+    // gives the entries back to the bank.
+    void free();
 
-    // Receives a char pointer and lenght, reads a string from it and saves on label.
-    bool setLabel(const char* text, int length);
+    // adds a scale point keeping the values sorted, returns false if all entries are written.
+    bool add(const char* label, int label_size, float value);
 
-    // Receives a pointer to the first byte from a float, reads next 3 bytes and cast to float in value.
-    void setValue(const uint8_t* first_byte);
+    // returns the position of the scale point with the value closest to value, -1 if there is none.
+    int nearest(float value);
 
-    // Receives a char buffer as output parameter and writes label in it until buffer_size or label.lenght .
-    int getLabel(char* buffer, int buffer_size=0);
+    // Returns value of the scale point at position i.
+    float getValue(int i);
 
-    // Returns value in float.
-    float getValue();
+    // writes the label of the scale point at position i on buffer until buffer_size or the label length.
+    int getLabel(int i, char* buffer, int buffer_size=0);
 
-    // Returns next SP from the list.
-    ScalePoint* getNext();
-
-    // Returns previous SP from the list.
-    ScalePoint* getPrevious();
-
-    // Set next SP on the list.
-    void setNext(ScalePoint* next);
-
-
-    // Set previous SP on the list.
-    void setPrevious(ScalePoint* previous);
+    // usage of the entries shared by all lists.
+    static pool_stats_t poolStats();
 };
 
-#endif
\ No newline at end of file
+#endif
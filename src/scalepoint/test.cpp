@@ -4,90 +4,44 @@
 
 using namespace std;
 
-int main(){
-
-	ScalePoint *sp_list;
-	ScalePoint *sp_list_aux;
-	ScalePoint sp;
-	ScalePoint sp2;
-	ScalePoint sp3;
-
-	uint8_t* pchar;
-
-	char buff[10];
-	char buff2[10];
-	char buff3[10];
-
-	float val = 12.4;
-
-	pchar = (uint8_t*) &val;
-
-	sp_list = &sp;
-
-	if(sp_list->allocScalePoint()){
-		sp_list->setLabel("Scale1", 6);
-		sp_list->setValue(pchar);
-
-		sp_list_aux = sp_list;
-		sp_list->setNext(&sp2);
-		sp_list = sp_list->getNext();
-		sp_list->setPrevious(sp_list_aux);
-
-	}
-	val = 2*12.4;
-	if(sp_list->allocScalePoint()){
-		sp_list->setLabel("Scale2", 6);
-
-		cout << "val" << val << endl;
-
-		sp_list->setValue(pchar);
-
-		sp_list_aux = sp_list;
-		sp_list->setNext(&sp3);
-		sp_list = sp_list->getNext();
-		sp_list->setPrevious(sp_list_aux);
+void printList(ScalePointList* list){
+	char buff[MAX_STRING_SIZE + 1];
 
+	for (int i = 0; i < list->count; ++i){
+		buff[list->getLabel(i, buff)] = 0;
+		cout << buff << ": " << list->getValue(i) << " ";
 	}
-	val = 3*12.4;
-	if(sp_list->allocScalePoint()){
-		sp_list->setLabel("Scale3", 6);
-		sp_list->setValue(pchar);
+	cout << endl;
+}
 
-		sp_list = sp_list->getPrevious();
-		sp_list = sp_list->getPrevious();
+int main(){
+	ScalePointList list, list2, list3;
+
+	// added out of order, kept sorted
+	cout << "alloc: " << list.alloc(4) << endl;
+	list.add("Mid", 3, 0.5);
+	list.add("High", 4, 1);
+	list.add("Low", 3, 0);
+	list.add("Quarter", 7, 0.25);
+	cout << "full: " << list.add("Extra", 5, 2) << endl;
+	printList(&list);
+
+	const float values[] = {-1, 0.1, 0.2, 0.375, 0.7, 0.8, 5};
+	for (int i = 0; i < (int) (sizeof(values)/sizeof(values[0])); ++i){
+		cout << "nearest " << values[i] << ": " << list.getValue(list.nearest(values[i])) << endl;
 	}
+	cout << "nearest on empty: " << list3.nearest(1) << endl;
 
-	sp_list->getLabel(buff,6);
-	sp_list = sp_list->getNext();
-	sp_list->getLabel(buff2,6);
-	sp_list = sp_list->getNext();
-	sp_list->getLabel(buff3,6);
-
-	sp_list = sp_list->getPrevious();
-	sp_list = sp_list->getPrevious();
-
-	buff[6] = 0;
-	buff2[6] = 0;
-	buff3[6] = 0;
-
-	cout << buff << ": " << sp_list->getValue() << endl;
-	sp_list = sp_list->getNext();
-	cout << buff2 << ": " << sp_list->getValue() << endl;
-	sp_list = sp_list->getNext();
-	cout << buff3 << ": " << sp_list->getValue() << endl;
-
-	// sp.freeScalePoint();
-
-	// sp1.setLabel("lucas", 5);
-	// if(sp2.allocScalePoint()){
-	// 	cout << "RESET: " << sp2.setLabel("locas", 3) << endl;
-	// 	sp2.getLabel(buff2,5);
-	// }
+	// the lists take consecutive entries, a free hole is only reused by a list which fits on it
+	cout << "alloc: " << list2.alloc(2) << " " << list3.alloc(3) << endl;
+	list.free();
+	cout << "alloc: " << list3.alloc(5) << endl;
+	list2.free();
+	cout << "alloc: " << list3.alloc(6) << endl;
 
-	// while(!sp3.allocScalePoint()){
-	// 	cout << "nao tem mais" << endl;
-	// 	sp.freeScalePoint();
-	// }
+	pool_stats_t stats = ScalePointList::poolStats();
+	cout << "capacity: " << stats.capacity << " used: " << stats.used << " high water: " << stats.high_water;
+	cout << " failures: " << stats.failures << endl;
 
 	return 0;
-}
\ No newline at end of file
+}
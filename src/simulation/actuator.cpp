@@ -0,0 +1 @@
+../actuator/actuator.cpp
\ No newline at end of file
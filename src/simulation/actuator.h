@@ -0,0 +1 @@
+../actuator/actuator.h
\ No newline at end of file
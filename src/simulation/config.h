@@ -0,0 +1 @@
+../config.h
\ No newline at end of file
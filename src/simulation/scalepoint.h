@@ -0,0 +1 @@
+../scalepoint/scalepoint.h
\ No newline at end of file
@@ -0,0 +1 @@
+../stimer/stimer.h
\ No newline at end of file
@@ -0,0 +1 @@
+../str/str.cpp
\ No newline at end of file
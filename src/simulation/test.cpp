@@ -0,0 +1,222 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "comm.h"
+#include "device.h"
+
+// Simulates N devices powering up together on the same rs-485 bus and measures how long it takes until the host
+// answered all of them. Each device runs its loop at a different phase inside the 1 ms tick, frames take the bus for
+// their length at BAUD_RATE and frames overlapping each other arrive garbled. The host answers every frame it gets
+// clean. The host data requests to the devices already connected aren't simulated.
+
+#define MAX_DEVICES         64
+#define MAX_FRAMES          (2*MAX_DEVICES)
+#define SENSE_DELAY_US      30          // a frame is only heard after its first bytes
+#define HOST_DELAY_US       100         // host time to answer
+#define SIMULATION_LIMIT    60000       // in ms
+
+typedef struct FRAME_T {
+    uint32_t start, end;                // in us
+    int device;                         // sender, -1 for the host
+    int dest;                           // device answered by the host frame
+    bool garbled;
+} frame_t;
+
+const char url[] = "http://portalmod.com/devices/XP";
+
+Device* devs[MAX_DEVICES];
+uint32_t devs_phase[MAX_DEVICES];
+int devs_count;
+
+frame_t frames[MAX_FRAMES];
+int frames_count;
+
+uint32_t now_us;
+int current;
+uint16_t garbled_frames;
+int sent_frames;
+uint16_t sent_size;
+
+uint32_t airTime(int size){
+    // start + 8 data + stop bits
+    return (uint32_t) size * 10 * 1000000 / BAUD_RATE + 1;
+}
+
+void busSend(int device, int dest, uint32_t start, int size){
+    frame_t* frame = &frames[frames_count++];
+
+    frame->start = start;
+    frame->end = start + airTime(size);
+    frame->device = device;
+    frame->dest = dest;
+    frame->garbled = false;
+
+    for (int i = 0; i < frames_count - 1; ++i){
+        if(frames[i].start < frame->end && frame->start < frames[i].end){
+            frames[i].garbled = true;
+            frame->garbled = true;
+        }
+    }
+}
+
+// only the frames size matters to the bus, the data isn't kept
+void msgBegin(uint8_t destination, uint8_t origin, uint8_t function, uint16_t data_size){
+    (void) destination; (void) origin; (void) function;
+    sent_size = HEADER_SIZE + data_size;
+}
+
+void msgPutU8(uint8_t value){
+    (void) value;
+}
+
+void msgPut(const void* data, uint16_t size){
+    (void) data; (void) size;
+}
+
+bool msgEnd(){
+    sent_frames++;
+    busSend(current, 0, now_us, sent_size);
+    return true;
+}
+
+const frame_writer_t msg_writer = {msgBegin, msgPutU8, msgPut, msgEnd};
+
+bool busBusy(){
+    for (int i = 0; i < frames_count; ++i){
+        if(frames[i].start + SENSE_DELAY_US <= now_us && now_us < frames[i].end)
+            return true;
+    }
+    return false;
+}
+
+uint16_t busErrors(){
+    return garbled_frames;
+}
+
+// the host connection response to the device
+void hostConnect(int k){
+    uint8_t msg[CHAIN_BUFFER_SIZE];
+    int i = POS_DATA_SIZE2 + 1;
+
+    msg[POS_SYNC] = CHAIN_SYNC_BYTE;
+    msg[POS_DEST] = CHAIN_FIRST_DEV_ADDR + k;
+    msg[POS_ORIG] = HOST_ADDRESS;
+    msg[POS_FUNC] = FUNC_CONNECTION;
+
+    msg[i++] = devs[k]->url_size;
+    for (int j = 0; j < devs[k]->url_size; ++j){
+        msg[i++] = devs[k]->url_id[j];
+    }
+    msg[i++] = devs[k]->channel;
+    msg[i++] = PROTOCOL_VERSION_BYTE1;
+    msg[i++] = PROTOCOL_VERSION_BYTE2;
+
+    msg[POS_DATA_SIZE1] = (i - POS_DATA_SIZE2 - 1) & 0xFF;
+    msg[POS_DATA_SIZE2] = (i - POS_DATA_SIZE2 - 1) >> 8;
+
+    devs[k]->parse(msg);
+}
+
+// finishes the frames that left the bus until now_us
+void busUpdate(){
+    for (int i = 0; i < frames_count; ++i){
+        frame_t frame = frames[i];
+
+        if(frame.end > now_us)
+            continue;
+
+        frames[i--] = frames[--frames_count];
+
+        if(frame.garbled){
+            garbled_frames++;
+        }
+        else if(frame.device >= 0){
+            busSend(-1, frame.device, frame.end + HOST_DELAY_US, HEADER_SIZE + devs[frame.device]->url_size + 4);
+        }
+        else{
+            hostConnect(frame.dest);
+        }
+    }
+}
+
+// returns the time in ms until all devices connected
+uint32_t simulate(int count, bool bus_callbacks, unsigned seed){
+    uint32_t start = STimer::static_timer_count;
+    int connected = 0;
+
+    srand(seed);
+
+    devs_count = count;
+    frames_count = 0;
+    garbled_frames = 0;
+    sent_frames = 0;
+
+    // identical devices, only the channel tells them apart
+    for (int k = 0; k < count; ++k){
+        devs[k] = new Device(url, "Expression Pedal", k + 1);
+        devs[k]->setWriter(&msg_writer);
+        if(bus_callbacks)
+            devs[k]->setBusCallbacks(busBusy, busErrors);
+        devs[k]->init();
+
+        devs_phase[k] = (rand() % 100) * 10;
+    }
+
+    for (uint32_t t = 0; t < SIMULATION_LIMIT && connected < count; ++t){
+        STimer::clock();
+
+        for (uint32_t us = 0; us < 1000; us += 10){
+            now_us = t*1000 + us;
+            busUpdate();
+
+            for (int k = 0; k < count; ++k){
+                if(devs_phase[k] != us || devs[k]->state != CONNECTING)
+                    continue;
+
+                current = k;
+                devs[k]->run();
+            }
+        }
+
+        connected = 0;
+        for (int k = 0; k < count; ++k){
+            if(devs[k]->state != CONNECTING)
+                connected++;
+        }
+    }
+
+    for (int k = 0; k < count; ++k){
+        delete devs[k];
+    }
+
+    return STimer::static_timer_count - start;
+}
+
+int main(){
+    const int counts[] = {1, 2, 4, 8, 16, 32, 64};
+    const int trials = 5;
+
+    printf("devices bus_callbacks worst_ms mean_ms frames garbled\n");
+
+    for (int c = 0; c < (int)(sizeof(counts)/sizeof(counts[0])); ++c){
+        for (int callbacks = 0; callbacks < 2; ++callbacks){
+            uint32_t worst = 0, sum = 0;
+            int frames = 0, garbled = 0;
+
+            for (int trial = 0; trial < trials; ++trial){
+                uint32_t time = simulate(counts[c], callbacks, trial + 1);
+
+                if(time > worst)
+                    worst = time;
+                sum += time;
+                frames += sent_frames;
+                garbled += garbled_frames;
+            }
+
+            printf("%7i %13i %8u %7u %6i %7i\n", counts[c], callbacks, worst, sum / trials, frames / trials, garbled / trials);
+        }
+    }
+
+    return 0;
+}
@@ -1,40 +1,30 @@
 #include "str.h"
 
+// the text of a string, wrapped so the pool holds it as a single item
+typedef struct STR_SLOT_T {
+    char text[MAX_STRING_SIZE];
+} str_slot_t;
+
 class STRBank
 {
 public:
-    char bank[MAX_STRING_COUNT][MAX_STRING_SIZE];
-    bool occupied[MAX_STRING_COUNT];
+    Pool<str_slot_t, MAX_STRING_COUNT> pool;
 
-    STRBank(){
-        for (int i = 0; i < MAX_STRING_COUNT; ++i){
-            occupied[i] = false;
-        }
-    }
+    STRBank(){}
     ~STRBank(){}
 
     char* allocStr(){
-        for(int i = 0; i < MAX_STRING_COUNT; ++i){
-            if(!occupied[i]){
-                occupied[i] = true;
-                return bank[i];
-            }
-        }
-        return 0;
+        str_slot_t* slot = pool.alloc();
+
+        return slot ? slot->text : 0;
     }
 
     void freeStr(char* &text){
-        int index;
-
         if(!text){
             return;
         }
 
-        index = (text-bank[0])/MAX_STRING_SIZE;
-
-        if(index >= 0 && index < MAX_STRING_COUNT){
-            occupied[index] = false;
-        }
+        pool.free((str_slot_t*) text);
 
         text = 0; //NULL
     }
@@ -102,6 +92,10 @@ int Str::getLength(){
     return this->length;
 }
 
+pool_stats_t Str::poolStats(){
+    return strBank.pool.getStats();
+}
+
 // bool Str::operator==(const Str &str) const {
 //  if(this->length == str.length){
 //      for(int i = 0; i < this->length; i++){
@@ -2,6 +2,7 @@
 #define STR_H
 
 #include "config.h"
+#include "pool.h"
 
 #ifndef MAX_STRING_COUNT
 #define MAX_STRING_COUNT 100 // test with 3.
@@ -37,6 +38,9 @@ public:
     // returns text length;
     int getLength();
 
+    // usage of the strings shared by all Str.
+    static pool_stats_t poolStats();
+
     // bool operator==(const Str &str) const;
 
     // bool operator==(const char* &str) const;